@@ -0,0 +1,81 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "avr/avr_mcu_section.h"
+#include "bench.h"
+
+// Tell simavr which part and clock to simulate, and where the console is
+AVR_MCU(F_CPU, "attiny88");
+AVR_MCU_SIMAVR_CONSOLE(&GPIOR0);
+
+static volatile uint16_t overflows;
+static uint16_t overhead;
+
+ISR(TIMER1_OVF_vect) {
+  overflows++;
+}
+
+void bench_init(void) {
+  TCCR1A = 0;
+  TCCR1B = 1<<CS10;
+  TIMSK1 = 1<<TOIE1;
+  sei();
+  // Measure an empty section so it can be taken off every result
+  bench_start();
+  overhead = bench_stop();
+}
+
+void bench_start(void) {
+  cli();
+  overflows = 0;
+  TIFR1 = 1<<TOV1;
+  TCNT1 = 0;
+  sei();
+}
+
+uint32_t bench_stop(void) {
+  uint16_t low = TCNT1;
+  cli();
+  uint16_t high = overflows;
+  // An overflow that happened while the section had interrupts off has not been counted yet
+  if((TIFR1 & (1<<TOV1)) && low < 0x8000) {
+    high++;
+  }
+  sei();
+  return ((((uint32_t)high)<<16) | low) - overhead;
+}
+
+static void bench_puts_P(const char *s) {
+  char c;
+  while((c = pgm_read_byte(s++))) {
+    GPIOR0 = c;
+  }
+}
+
+static void bench_puts(const char *s) {
+  while(*s) {
+    GPIOR0 = *s++;
+  }
+}
+
+void bench_report_P(const char *name, uint32_t value, const char *unit) {
+  char number[11];
+  bench_puts_P(PSTR("bench,"));
+  bench_puts_P(name);
+  GPIOR0 = ',';
+  bench_puts(ultoa(value, number, 10));
+  GPIOR0 = ',';
+  bench_puts_P(unit);
+  GPIOR0 = '\n';
+}
+
+void bench_done(void) {
+  // simavr ends the simulation when the CPU sleeps with interrupts off
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  cli();
+  sleep_enable();
+  sleep_cpu();
+}
@@ -0,0 +1,21 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+// Cycle counting and reporting for the benchmark ELFs, which run under simavr
+// Timer1 counts every CPU cycle and its overflow interrupt extends it to 32 bits
+
+// Start the cycle counter and enable interrupts
+void bench_init(void);
+// Start timing a section
+void bench_start(void);
+// Stop timing and return the cycles since bench_start, minus the cost of the calls themselves
+uint32_t bench_stop(void);
+// Print one machine-readable result line, "bench,<name>,<value>,<unit>", on the simavr console
+void bench_report_P(const char *name, uint32_t value, const char *unit);
+#define bench_report(name, value, unit) bench_report_P(PSTR(name), value, PSTR(unit))
+// Stop the simulation
+void bench_done(void);
+
+#endif //__BENCH_H__
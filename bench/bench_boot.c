@@ -0,0 +1,53 @@
+// Time the boot from the RTC's first read to the first frame on the LEDs, against the software MCP7940 in sim/
+// The model answers instantly, so the bus time is worked out from the traffic and added on, as in bench_rtc.c
+#include <stdint.h>
+#include <stdbool.h>
+#include "bench.h"
+#include "../display.h"
+#include "../clock.h"
+#include "../settings.h"
+#include "../mcp7940_tiny.h"
+#include "../sim/mcp7940_model.h"
+#include "../stack.h"
+
+static uint32_t busCycles(void) {
+  return mcp7940_model_busBits()*(F_CPU/mcp7940_model_scl);
+}
+
+// The same steps main() takes up to the first frame, then the setup it leaves until after
+static void boot_P(const char *firstFrame, const char *setup) {
+  mcp7940_model_resetStats();
+  bench_start();
+  i2c_init();
+  i2c_setSpeed(I2C_SPEED_FAST);
+  clockBoot();
+  loadSettings();
+  invalidateDisplay();
+  updateDisplay(clockShownHours(), minutes, seconds, true);
+  uint32_t cycles = bench_stop() + busCycles();
+  bench_report_P(firstFrame, cycles, PSTR("cycles"));
+  bench_report_P(firstFrame, cycles/(F_CPU/1000000UL), PSTR("us"));
+
+  mcp7940_model_resetStats();
+  bench_start();
+  clockSetup();
+  cycles = bench_stop() + busCycles();
+  bench_report_P(setup, cycles, PSTR("cycles"));
+  bench_report_P(setup, mcp7940_model_stats.transactions, PSTR("transactions"));
+}
+#define boot(firstFrame, setup) boot_P(PSTR(firstFrame), PSTR(setup))
+
+int main(void) {
+  bench_init();
+  // A fresh RTC, oscillator stopped and the SRAM empty, as after the battery is fitted
+  mcp7940_model_reset();
+  boot("boot.cold.first_frame", "boot.cold.setup");
+  // Booting again once everything has been set up
+  boot("boot.warm.first_frame", "boot.warm.setup");
+  // The deepest the stack got booting, cold and warm
+  bench_report("boot.stack.max_depth", stack_maxDepth(), "bytes");
+  bench_report("boot.sram.high_water", stack_staticSize() + stack_maxDepth(), "bytes");
+
+  bench_done();
+  return 0;
+}
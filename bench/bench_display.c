@@ -0,0 +1,141 @@
+// Time the renderer and the WS2812 flush for the frames the clock actually draws
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "bench.h"
+#include "../display.h"
+#include "../effects.h"
+#include "../stack.h"
+
+// Lets the same benchmark be built for each DISPLAY_MODE and tell the results apart
+#ifndef BENCH_PREFIX
+#define BENCH_PREFIX ""
+#endif
+
+// How late the Timer0 overflow interrupt ran, in 256 cycle timer ticks
+volatile uint8_t lateness;
+
+ISR(TIMER0_OVF_vect) {
+  lateness = TCNT0;
+  TCCR0A = 0;
+}
+
+// Run a flush with a Timer0 overflow due 256 cycles in; the interrupt can only run once
+//  interrupts are back on, so how late it was is how long they were off (to within 256 cycles)
+static uint32_t irqOffWindow(void) {
+  lateness = 0;
+  TIMSK0 = 1<<TOIE0;
+  TIFR0 = 1<<TOV0;
+  TCNT0 = 0xFF;
+  TCCR0A = 1<<CS02;
+  flushDisplay();
+  while(TCCR0A);
+  TIMSK0 = 0;
+  return (uint32_t)lateness*256;
+}
+
+int main(void) {
+  uint32_t cycles;
+  bench_init();
+  updateDisplay(12, 34, 56, true);
+
+  // Every LED of every digit lit, the worst case for rendering
+  invalidateDisplay();
+  bench_start();
+  updateDisplay(88, 88, 88, true);
+  cycles = bench_stop();
+  bench_report(BENCH_PREFIX "updateDisplay.all_lit", cycles, "cycles/frame");
+  bench_report(BENCH_PREFIX "updateDisplay.all_lit.current", displayCurrentMA(), "mA");
+
+  // A normal second: the rainbow moves, so everything is redrawn and sent
+  bench_start();
+  stepAnimation();
+  updateDisplay(12, 34, 57, false);
+  cycles = bench_stop();
+  bench_report(BENCH_PREFIX "updateDisplay.tick", cycles, "cycles/frame");
+
+  // Only the seconds ones digit changed, without the animation moving
+  bench_start();
+  updateDisplay(12, 34, 58, false);
+  cycles = bench_stop();
+  bench_report(BENCH_PREFIX "updateDisplay.one_digit", cycles, "cycles/frame");
+
+  // Nothing changed, so nothing is rendered or sent
+  bench_start();
+  updateDisplay(12, 34, 58, false);
+  cycles = bench_stop();
+  bench_report(BENCH_PREFIX "updateDisplay.unchanged", cycles, "cycles/frame");
+
+  // The flush on its own is the time interrupts are off
+  bench_start();
+  flushDisplay();
+  cycles = bench_stop();
+  bench_report(BENCH_PREFIX "flushDisplay", cycles, "cycles/frame");
+  bench_report(BENCH_PREFIX "ws2812_set_single", cycles/MAX_LED, "cycles/led");
+  bench_report(BENCH_PREFIX "flushDisplay.irq_off", irqOffWindow(), "cycles");
+
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+  // Every LED lit with each effect, flush included; setEffect() refuses any whose declared cost doesn't fit
+  // The declared cost is what setEffect() went by, and over_declared (a baseline of 0) catches an effect
+  //  whose frameCycles or pixelCycles in effects.h are too low
+  const char *effectNames[EFFECT_COUNT] = {
+    PSTR(BENCH_PREFIX "effect.rainbow"), PSTR(BENCH_PREFIX "effect.solid"), PSTR(BENCH_PREFIX "effect.breathe"),
+    PSTR(BENCH_PREFIX "effect.digits"), PSTR(BENCH_PREFIX "effect.sparkle")
+  };
+  const char *declaredNames[EFFECT_COUNT] = {
+    PSTR(BENCH_PREFIX "effect.rainbow.declared"), PSTR(BENCH_PREFIX "effect.solid.declared"),
+    PSTR(BENCH_PREFIX "effect.breathe.declared"), PSTR(BENCH_PREFIX "effect.digits.declared"),
+    PSTR(BENCH_PREFIX "effect.sparkle.declared")
+  };
+  const char *overNames[EFFECT_COUNT] = {
+    PSTR(BENCH_PREFIX "effect.rainbow.over_declared"), PSTR(BENCH_PREFIX "effect.solid.over_declared"),
+    PSTR(BENCH_PREFIX "effect.breathe.over_declared"), PSTR(BENCH_PREFIX "effect.digits.over_declared"),
+    PSTR(BENCH_PREFIX "effect.sparkle.over_declared")
+  };
+  for(uint8_t id = 0; id < EFFECT_COUNT; id++) {
+    if(!setEffect(id)) {
+      continue;
+    }
+    updateDisplay(88, 88, 88, true);
+    bench_start();
+    stepAnimation();
+    updateDisplay(88, 88, 88, true);
+    cycles = bench_stop();
+    bench_report_P(effectNames[id], cycles, PSTR("cycles/frame"));
+    uint32_t declared = effectCost(id, TRANSITION_NONE);
+    bench_report_P(declaredNames[id], declared, PSTR("cycles/frame"));
+    bench_report_P(overNames[id], cycles > declared ? cycles - declared : 0, PSTR("cycles/frame"));
+  }
+  setEffect(EFFECT);
+
+  // Every slot part way through changing from 8 to 0, the worst frame of a transition
+  const char *transitionNames[TRANSITION_COUNT] = {
+    NULL, PSTR(BENCH_PREFIX "transition.crossfade"), PSTR(BENCH_PREFIX "transition.wipe"),
+    PSTR(BENCH_PREFIX "transition.dissolve")
+  };
+  for(uint8_t id = TRANSITION_CROSSFADE; id < TRANSITION_COUNT; id++) {
+    if(!setTransition(id)) {
+      continue;
+    }
+    tickAnimation(1);
+    updateDisplay(88, 88, 88, true);
+    updateDisplay(0, 0, 0, false);
+    bench_start();
+    tickAnimation(1);
+    updateDisplay(0, 0, 0, false);
+    cycles = bench_stop();
+    bench_report_P(transitionNames[id], cycles, PSTR("cycles/frame"));
+  }
+  setTransition(TRANSITION);
+#endif
+
+  // The deepest the stack got in all of the above, and the SRAM in use at that point with the static data
+  // Both are costs, so bench-check catches a feature that eats into the headroom
+  bench_report(BENCH_PREFIX "stack.max_depth", stack_maxDepth(), "bytes");
+  bench_report(BENCH_PREFIX "sram.high_water", stack_staticSize() + stack_maxDepth(), "bytes");
+
+  bench_done();
+  return 0;
+}
@@ -0,0 +1,40 @@
+// The longest the LED data line sits low between two LEDs of a flush, built with WS2812_GAP_STATS
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include "bench.h"
+#include "../display.h"
+#include "../ws2812.h"
+
+// Lets the same benchmark be built for each DISPLAY_MODE and tell the results apart
+#ifndef BENCH_PREFIX
+#define BENCH_PREFIX ""
+#endif
+
+uint16_t ws2812_gap_max;
+
+int main(void) {
+  bench_init();
+  // Timer1 only has to count here, and its overflow interrupt would land in the SPI back end's gaps
+  TIMSK1 = 0;
+
+  // Every LED lit is the slowest way through each flush loop; one frame takes the hue through every sector
+  //  and past the wrap, reloading the stream's mask every 8 LEDs, and moving the animation between frames
+  //  shifts which LED lands on each of those
+  updateDisplay(88, 88, 88, true);
+  ws2812_gap_max = 0;
+  for(uint8_t frame = 0; frame < 16; frame++) {
+    stepAnimation();
+    updateDisplay(88, 88, 88, true);
+    flushDisplay();
+  }
+
+  // The gap comes on top of the low time the last bit of an LED already has
+  uint32_t lowNs = WS2812_NS((uint32_t)ws2812_gap_max + WS2812_BIT_LOW_CYCLES);
+  bench_report(BENCH_PREFIX "flush.gap_max", lowNs, "ns");
+  // A baseline of 0 makes bench-check fail as soon as any LED's gap goes over WS2812_TLOW_MAX_NS
+  bench_report(BENCH_PREFIX "flush.gap_over_limit", lowNs > WS2812_TLOW_MAX_NS ? lowNs - WS2812_TLOW_MAX_NS : 0, "ns");
+
+  bench_done();
+  return 0;
+}
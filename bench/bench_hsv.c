@@ -0,0 +1,59 @@
+// Compare the old degree-based getRGB against the division-free hsvToRGB
+#include <stdint.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../hsv_rgb.h"
+
+#define PIXELS 128
+// The brightness the clock face uses
+#define VAL 50
+
+uint8_t color[3];
+uint8_t reference[3];
+
+int main(void) {
+  uint32_t cycles;
+  uint8_t pixel;
+  bench_init();
+
+  bench_start();
+  for(pixel = 0; pixel < PIXELS; pixel++) {
+    getRGB(3*pixel, VAL, color);
+  }
+  cycles = bench_stop();
+  bench_report("getRGB", cycles/PIXELS, "cycles/pixel");
+
+  bench_start();
+  for(pixel = 0; pixel < PIXELS; pixel++) {
+    hsvToRGB(HUE_DEGREES(3)*pixel, 255, VAL, color);
+  }
+  cycles = bench_stop();
+  bench_report("hsvToRGB", cycles/PIXELS, "cycles/pixel");
+
+  bench_start();
+  for(pixel = 0; pixel < PIXELS; pixel++) {
+    hsvToRGB(HUE_DEGREES(3)*pixel, 160, VAL, color);
+  }
+  cycles = bench_stop();
+  bench_report("hsvToRGB.desaturated", cycles/PIXELS, "cycles/pixel");
+
+  // Largest difference in any channel over the whole wheel at every brightness
+  uint8_t worst = 0;
+  for(uint16_t degrees = 0; degrees < 360; degrees++) {
+    uint8_t val = 255;
+    do {
+      getRGB(degrees, val, reference);
+      hsvToRGB(HUE_DEGREES(degrees), 255, val, color);
+      for(uint8_t channel = 0; channel < 3; channel++) {
+        uint8_t diff = abs(reference[channel] - color[channel]);
+        if(diff > worst) {
+          worst = diff;
+        }
+      }
+    } while(--val);
+  }
+  bench_report("hsvToRGB.max_channel_error", worst, "levels");
+
+  bench_done();
+  return 0;
+}
@@ -0,0 +1,93 @@
+// Time every mcp7940_* call against the software MCP7940 in sim/
+// The driver's own cycles are measured; the bus time is worked out from the traffic at MCP7940_MODEL_SCL
+#include <stdint.h>
+#include <stdbool.h>
+#include "bench.h"
+#include "../mcp7940_tiny.h"
+#include "../sim/mcp7940_model.h"
+
+// CPU cycles one SCL period takes
+#define CYCLES_PER_BIT (F_CPU/mcp7940_model_scl)
+
+static uint32_t cycles;
+
+static void begin(void) {
+  mcp7940_model_resetStats();
+  bench_start();
+}
+
+static void end_P(const char *name) {
+  cycles = bench_stop();
+  bench_report_P(name, cycles, PSTR("cycles"));
+  bench_report_P(name, mcp7940_model_busBits()*CYCLES_PER_BIT, PSTR("bus_cycles"));
+  bench_report_P(name, mcp7940_model_stats.transactions, PSTR("transactions"));
+}
+#define end(name) end_P(PSTR(name))
+
+int main(void) {
+  bench_init();
+  i2c_init();
+  mcp7940_model_reset();
+
+  begin();
+  mcp7940_init();
+  end("mcp7940_init");
+
+  begin();
+  mcp7940_getSeconds();
+  end("mcp7940_getSeconds");
+
+  begin();
+  mcp7940_getMinutes();
+  end("mcp7940_getMinutes");
+
+  begin();
+  mcp7940_getHours();
+  end("mcp7940_getHours");
+
+  mcp7940_time_t time;
+  begin();
+  mcp7940_getTime(&time);
+  end("mcp7940_getTime");
+
+  begin();
+  mcp7940_setTime(&time);
+  end("mcp7940_setTime");
+
+  i2c_setSpeed(I2C_SPEED_FAST);
+  begin();
+  mcp7940_getTime(&time);
+  end("fast.mcp7940_getTime");
+  i2c_setSpeed(I2C_SPEED_STANDARD);
+
+  begin();
+  mcp7940_getControlRegister();
+  end("mcp7940_getControlRegister");
+
+  begin();
+  mcp7940_setControlRegister((1<<MCP7940_SQWEN) | SQWV_1HZ);
+  end("mcp7940_setControlRegister");
+
+  begin();
+  mcp7940_setSeconds(30, true);
+  end("mcp7940_setSeconds");
+
+  begin();
+  mcp7940_setMinutes(45);
+  end("mcp7940_setMinutes");
+
+  begin();
+  mcp7940_setHours(11, true);
+  end("mcp7940_setHours");
+
+  begin();
+  mcp7940_setBatteryBackup(true);
+  end("mcp7940_setBatteryBackup");
+
+  begin();
+  mcp7940_setTrim(0b00111000);
+  end("mcp7940_setTrim");
+
+  bench_done();
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "buttons.h"
+#include "frame.h"
+#include "stack.h"
+
+// Where the current press is
+#define GESTURE_IDLE 0
+// Down, but still inside the combo window
+#define GESTURE_PENDING 1
+#define GESTURE_HELD 2
+#define GESTURE_COMBO 3
+// Let go inside the combo window; the press has been sent and the release is next
+#define GESTURE_RELEASING 4
+
+// Set by the pin change interrupt along with when it happened, cleared once the pins settle
+volatile bool buttonEdge = false;
+volatile uint16_t buttonEdgeAt;
+// The debounced state of the buttons, a bit set for each one held down
+uint8_t buttonsDown = 0;
+uint8_t gesture = GESTURE_IDLE;
+// The buttons in this gesture, when it started, and whether the long press has been sent
+uint8_t gestureButtons;
+uint16_t gestureAt;
+bool longSent;
+// When the next repeat is due, and the interval after that
+uint16_t repeatAt;
+uint16_t repeatInterval;
+
+ISR(PCINT0_vect) {
+  stack_sample();
+  buttonEdge = true;
+  buttonEdgeAt = millis;
+}
+
+void buttons_init(void) {
+  // Inputs with pull-ups, pressed pulls them low
+  DDRB &= ~BUTTON_ALL;
+  PORTB |= BUTTON_ALL;
+  //setup PCI0 for PCINT6 and 7, for PB6 and 7
+  PCMSK0 |= (1<<PCINT6) | (1<<PCINT7);
+  PCICR |= 1<<PCIE0;
+}
+
+bool buttons_busy(void) {
+  return buttonEdge || gesture != GESTURE_IDLE;
+}
+
+uint8_t buttons_poll(void) {
+  uint16_t now = frame_millis();
+  if(buttonEdge) {
+    cli();
+    uint16_t edgeAt = buttonEdgeAt;
+    sei();
+    if((uint16_t)(now - edgeAt) < BUTTON_DEBOUNCE_MS) {
+      return BUTTON_NONE;
+    }
+    buttonEdge = false;
+    buttonsDown = (~PINB) & BUTTON_ALL;
+  }
+
+  switch(gesture) {
+    case GESTURE_IDLE:
+      if(buttonsDown) {
+        gesture = GESTURE_PENDING;
+        gestureButtons = buttonsDown;
+        gestureAt = now;
+        longSent = false;
+      }
+      break;
+
+    case GESTURE_PENDING:
+      gestureButtons |= buttonsDown;
+      if(gestureButtons == BUTTON_ALL) {
+        gesture = GESTURE_COMBO;
+        return BUTTON_COMBO | gestureButtons;
+      }
+      if(!buttonsDown) {
+        gesture = GESTURE_RELEASING;
+        return BUTTON_PRESS | gestureButtons;
+      }
+      if((uint16_t)(now - gestureAt) >= BUTTON_COMBO_MS) {
+        gesture = GESTURE_HELD;
+        repeatAt = gestureAt + BUTTON_REPEAT_DELAY_MS;
+        repeatInterval = BUTTON_REPEAT_FIRST_MS;
+        return BUTTON_PRESS | gestureButtons;
+      }
+      break;
+
+    case GESTURE_HELD:
+      if(!buttonsDown) {
+        gesture = GESTURE_IDLE;
+        return BUTTON_RELEASE | gestureButtons;
+      }
+      if(!longSent && (uint16_t)(now - gestureAt) >= BUTTON_LONG_MS) {
+        longSent = true;
+        return BUTTON_LONG | gestureButtons;
+      }
+      // Signed, so the comparison still works across the millisecond counter wrapping
+      // Counted from now, so a late loop gets one repeat rather than a burst of them
+      if((int16_t)(now - repeatAt) >= 0) {
+        repeatAt = now + repeatInterval;
+        repeatInterval -= repeatInterval/8;
+        if(repeatInterval < BUTTON_REPEAT_FASTEST_MS) {
+          repeatInterval = BUTTON_REPEAT_FASTEST_MS;
+        }
+        return BUTTON_REPEAT | gestureButtons;
+      }
+      break;
+
+    case GESTURE_COMBO:
+      if(!buttonsDown) {
+        gesture = GESTURE_IDLE;
+        return BUTTON_RELEASE | gestureButtons;
+      }
+      break;
+
+    case GESTURE_RELEASING:
+      gesture = GESTURE_IDLE;
+      return BUTTON_RELEASE | gestureButtons;
+  }
+  return BUTTON_NONE;
+}
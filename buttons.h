@@ -0,0 +1,60 @@
+#ifndef __BUTTONS_H__
+#define __BUTTONS_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+
+// The buttons, as masks of their PORTB pins
+#define BUTTON_HOUR (1<<PB6)
+#define BUTTON_MIN (1<<PB7)
+#define BUTTON_ALL (BUTTON_HOUR | BUTTON_MIN)
+
+// How long the pins have to stay quiet after an edge before the new state counts
+#ifndef BUTTON_DEBOUNCE_MS
+#define BUTTON_DEBOUNCE_MS 20
+#endif
+// How long after the first button goes down the second can join it for a combo
+// A single press is only reported once this has passed
+#ifndef BUTTON_COMBO_MS
+#define BUTTON_COMBO_MS 60
+#endif
+// How long a button has to be held to count as a long press
+#ifndef BUTTON_LONG_MS
+#define BUTTON_LONG_MS 1500
+#endif
+// Auto-repeat starts this long after the press, at the first interval, and each repeat
+//  takes an eighth off the interval until it reaches the fastest
+#ifndef BUTTON_REPEAT_DELAY_MS
+#define BUTTON_REPEAT_DELAY_MS 500
+#endif
+#ifndef BUTTON_REPEAT_FIRST_MS
+#define BUTTON_REPEAT_FIRST_MS 250
+#endif
+#ifndef BUTTON_REPEAT_FASTEST_MS
+#define BUTTON_REPEAT_FASTEST_MS 30
+#endif
+
+// What buttons_poll() saw, in the low bits of an event; the buttons involved are in the high bits
+#define BUTTON_NONE 0
+// One button went down (and the other didn't follow it in time for a combo)
+#define BUTTON_PRESS 1
+// The button is still held and it is time for another step
+#define BUTTON_REPEAT 2
+// The button has been held for BUTTON_LONG_MS; sent once, alongside the repeats
+#define BUTTON_LONG 3
+// Both buttons went down together; no presses or repeats follow until they are released
+#define BUTTON_COMBO 4
+// Every button has been let go, ending the press or combo
+#define BUTTON_RELEASE 5
+#define BUTTON_KIND(event) ((event) & 0x07)
+#define BUTTON_WHICH(event) ((event) & BUTTON_ALL)
+
+// Set up the pins and their pin change interrupt; needs frame_init() for the millisecond tick
+void buttons_init(void);
+// Move the state machine on and return the next event, BUTTON_NONE if there is none
+// Call it until it returns BUTTON_NONE; it never waits
+uint8_t buttons_poll(void);
+// Whether a button is down or bouncing, so buttons_poll() needs calling again soon
+bool buttons_busy(void);
+
+#endif //__BUTTONS_H__
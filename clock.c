@@ -0,0 +1,245 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "clock.h"
+#include "mcp7940_tiny.h"
+#include "trim.h"
+
+volatile uint8_t seconds = 99;
+volatile uint8_t minutes = 99;
+volatile uint8_t hours = 99;
+uint8_t date = 1;
+uint8_t month = 1;
+uint8_t year = 0;
+// 1 January 2000 was a Saturday
+uint8_t weekday = 6;
+bool dst = false;
+bool use12h = USE_12H;
+// The mode the RTC keeps its hours register in, and whether it needs changing to match use12h
+static bool rtc12h;
+static bool modeWanted = false;
+// RTCSEC through OSCTRIM as clockBoot() read them and as clockSetup() has left them
+static uint8_t regs[MCP7940_OSCTRIM + 1];
+// The day has wrapped or the count went wrong, and the RTC should be read to correct it
+bool resyncWanted = false;
+
+static uint8_t daysInMonth(uint8_t m, uint8_t y) {
+  if(m == 2) {
+    // Every fourth year from 2000, which was one, to 2099
+    return (y & 3) ? 28 : 29;
+  }
+  // 31 days in odd months up to July and even ones from August
+  return 30 + ((m ^ (m >> 3)) & 1);
+}
+
+static uint16_t daysSince2000(uint8_t y, uint8_t m, uint8_t d) {
+  uint16_t days = y * 365U + (y + 3) / 4 + d - 1;
+  for(uint8_t i = 1; i < m; i++) {
+    days += daysInMonth(i, y);
+  }
+  return days;
+}
+
+// Work the weekday out from scratch, which only happens when the date is read from the RTC
+// The RTC's own weekday register is left alone, since nothing ever set it
+static void findWeekday(void) {
+  weekday = (daysSince2000(year, month, date) + 6) % 7;
+}
+
+uint32_t clockTimestamp(const mcp7940_time_t *time) {
+  uint32_t days = daysSince2000(time->year, time->month, time->date);
+  return ((days*24 + time->hours)*60 + time->minutes)*60 + time->seconds;
+}
+
+#if DST_RULE != DST_NONE
+// Whether this month's transition, on the given Sunday (5 for the last) at the given standard hour, has happened
+static bool pastTransition(uint8_t sunday, uint8_t hour) {
+  // The date of the month's first Sunday, counting back from today
+  uint8_t day = (date + 6 - weekday) % 7 + 1;
+  day += (sunday - 1) * 7;
+  if(day > daysInMonth(month, year)) {
+    day -= 7;
+  }
+  return date > day || (date == day && hours >= hour);
+}
+
+static bool dstInEffect(void) {
+  if(month == DST_START_MONTH) {
+    return pastTransition(DST_START_SUNDAY, DST_START_HOUR);
+  }
+  if(month == DST_END_MONTH) {
+    return !pastTransition(DST_END_SUNDAY, DST_END_HOUR);
+  }
+  return month > DST_START_MONTH && month < DST_END_MONTH;
+}
+#else
+#define dstInEffect() false
+#endif
+
+// Take the time and date from the RTC
+static void applyTime(const mcp7940_time_t *now) {
+  minutes = now->minutes;
+  hours = now->hours;
+  date = now->date;
+  month = now->month;
+  year = now->year;
+  findWeekday();
+  dst = dstInEffect();
+}
+
+static void nextDay(void) {
+  weekday = weekday == 6 ? 0 : weekday + 1;
+  if(date < daysInMonth(month, year)) {
+    date++;
+    return;
+  }
+  date = 1;
+  if(month < 12) {
+    month++;
+    return;
+  }
+  month = 1;
+  year = year == 99 ? 0 : year + 1;
+}
+
+uint8_t clockBoot(void) {
+  // The time and everything the setup checks, in one read
+  uint8_t failCode = mcp7940_readRegisters(MCP7940_RTCSEC, regs, sizeof(regs));
+  if(failCode) {
+    return failCode;
+  }
+  mcp7940_time_t now;
+  mcp7940_decodeTime(regs, &now);
+  seconds = now.seconds;
+  applyTime(&now);
+  rtc12h = now.mode12h;
+  modeWanted = rtc12h != use12h;
+  return 0;
+}
+
+void clockSetup(void) {
+  uint8_t wanted[sizeof(regs)];
+  for(uint8_t reg = 0; reg < sizeof(regs); reg++) {
+    wanted[reg] = regs[reg];
+  }
+  // The oscillator running, on the battery when the power goes, a 1Hz square wave on MFP, and
+  //  the trim learned from the corrections made so far (see trim.h)
+  wanted[MCP7940_RTCSEC] |= 1<<MCP7940_ST;
+  wanted[MCP7940_RTCWKDAY] |= 1<<MCP7940_VBATEN;
+  wanted[MCP7940_CONTROL] = (1<<MCP7940_SQWEN) | SQWV_1HZ;
+  wanted[MCP7940_OSCTRIM] = mcp7940_trimRegister(trimLoad());
+  // Each run of registers that differ goes in one burst; ST is only ever off with the oscillator stopped,
+  //  so writing back the seconds with it can't lose a tick
+  uint8_t reg = 0;
+  while(reg < sizeof(regs)) {
+    if(wanted[reg] == regs[reg]) {
+      reg++;
+      continue;
+    }
+    uint8_t end = reg + 1;
+    while(end < sizeof(regs) && wanted[end] != regs[end]) {
+      end++;
+    }
+    if(mcp7940_writeRegisters(reg, &wanted[reg], end - reg) == I2C_OK) {
+      for(; reg < end; reg++) {
+        regs[reg] = wanted[reg];
+      }
+    }
+    reg = end;
+  }
+}
+
+void clockSet12Hour(bool on) {
+  use12h = on;
+  // Keep the RTC in the same mode as the face, though the hours read back 0-23 either way,
+  //  from clockUpdate() so it never holds up the first frame
+  modeWanted = rtc12h != on;
+}
+
+void clockUpdate(void) {
+  if(seconds>59) {
+    seconds = seconds % 60;
+    minutes++;
+    if(minutes == 60) {
+      // Carry the hour here so the face never shows :60
+      minutes = 0;
+      hours++;
+      if(hours == 24) {
+        hours = 0;
+        nextDay();
+        // Check the count against the RTC once a day, in the background
+        resyncWanted = true;
+      }
+      dst = dstInEffect();
+    }
+  }
+  if(modeWanted && mcp7940_setHours(hours, use12h) == I2C_OK) {
+    rtc12h = use12h;
+    modeWanted = false;
+  }
+  if(resyncWanted && mcp7940_startTimeRead()) {
+    resyncWanted = false;
+  }
+  mcp7940_time_t now;
+  if(mcp7940_timeReadDone(&now)) {
+    // A second that ticked between the read and here has been counted already, so keep it on top of the RTC's time
+    uint8_t ahead = (seconds + 60 - now.seconds) % 60 == 1;
+    seconds = now.seconds + ahead;
+    applyTime(&now);
+  }
+}
+
+bool clockIsNight(void) {
+#if NIGHT_MODE
+  uint8_t shown = dst ? (hours + 1) % 24 : hours;
+#if NIGHT_START_HOUR < NIGHT_END_HOUR
+  return shown >= NIGHT_START_HOUR && shown < NIGHT_END_HOUR;
+#else
+  return shown >= NIGHT_START_HOUR || shown < NIGHT_END_HOUR;
+#endif
+#else
+  return false;
+#endif
+}
+
+uint8_t clockNightBegin(void) {
+  // The RTC keeps standard time, so in summer the alarm is an hour earlier by its count
+  mcp7940_alarm_t end = {0, 0, NIGHT_END_HOUR, 0, 0, 0, MCP7940_MATCH_HOURS};
+  if(dst) {
+    end.hours = (NIGHT_END_HOUR + 23) % 24;
+  }
+  uint8_t failCode = mcp7940_setAlarm(0, &end);
+  if(!failCode) {
+    // Active low, for INT0's level interrupt
+    failCode = mcp7940_setAlarmPolarity(false);
+  }
+  if(!failCode) {
+    failCode = mcp7940_setControlRegister((1<<MCP7940_OUT) | (1<<MCP7940_ALM0EN));
+  }
+  return failCode;
+}
+
+void clockNightEnd(void) {
+  mcp7940_setControlRegister((1<<MCP7940_SQWEN) | SQWV_1HZ);
+  mcp7940_clearAlarm(0);
+  resyncWanted = true;
+}
+
+void clockResync(void) {
+  resyncWanted = true;
+}
+
+uint8_t clockShownHours(void) {
+  uint8_t shown = hours;
+  if(dst) {
+    shown = shown == 23 ? 0 : shown + 1;
+  }
+  if(use12h) {
+    if(shown == 0) {
+      return 12;
+    }
+    if(shown > 12) {
+      return shown - 12;
+    }
+  }
+  return shown;
+}
@@ -0,0 +1,95 @@
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include "mcp7940_tiny.h"
+
+// 1: Use 12 h clock
+// 0: Use 24 h clock
+// This is only the default, see clockSet12Hour()
+#ifndef USE_12H
+#define USE_12H 1
+#endif
+
+// Daylight saving time, added to the hours on the face; the RTC and the calendar here always keep standard time
+// The start month has to come before the end month, as it does north of the equator
+#define DST_NONE 0
+// Last Sunday in March to the last Sunday in October, at 01:00 UTC
+#define DST_EU 1
+// Second Sunday in March to the first Sunday in November, at 02:00 local time
+#define DST_US 2
+#ifndef DST_RULE
+#define DST_RULE DST_NONE
+#endif
+
+// Each transition is a month, which Sunday of it (1-4, or 5 for the last) and the hour in standard time
+#if DST_RULE == DST_EU
+#define DST_START_MONTH 3
+#define DST_START_SUNDAY 5
+#define DST_END_MONTH 10
+#define DST_END_SUNDAY 5
+// 01:00 UTC in central European time; one less for UK time, one more for eastern Europe
+#ifndef DST_HOUR
+#define DST_HOUR 2
+#endif
+#define DST_START_HOUR DST_HOUR
+#define DST_END_HOUR DST_HOUR
+#elif DST_RULE == DST_US
+#define DST_START_MONTH 3
+#define DST_START_SUNDAY 2
+#define DST_END_MONTH 11
+#define DST_END_SUNDAY 1
+// 02:00 standard time going forward, and 02:00 daylight time (01:00 standard) going back
+#define DST_START_HOUR 2
+#define DST_END_HOUR 1
+#endif
+
+// Night: from NIGHT_START_HOUR to NIGHT_END_HOUR on the face the LEDs are off, SQW is turned off and
+//  the chip can sleep in power-down until alarm 0 pulls MFP low at the end of the night
+// The same hour for both (the default) leaves it out
+#ifndef NIGHT_START_HOUR
+#define NIGHT_START_HOUR 0
+#endif
+#ifndef NIGHT_END_HOUR
+#define NIGHT_END_HOUR 0
+#endif
+#define NIGHT_MODE (NIGHT_START_HOUR != NIGHT_END_HOUR)
+
+// The time being shown, hours 0-23; seconds is counted up by the SQW interrupt and may briefly pass 59
+extern volatile uint8_t seconds;
+extern volatile uint8_t minutes;
+extern volatile uint8_t hours;
+// The date, kept by carrying the hours along; year is 0-99 for 2000-2099 and weekday is 0-6 from Sunday
+extern uint8_t date;
+extern uint8_t month;
+extern uint8_t year;
+extern uint8_t weekday;
+// Daylight saving time is in effect, so the face is an hour ahead of hours
+extern bool dst;
+// The face shows 12 hour time
+extern bool use12h;
+
+// Read the time and the RTC's setup in one burst, enough to draw the first frame
+// Returns nonzero if the RTC did not answer
+uint8_t clockBoot(void);
+// Set the RTC up the way the clock needs it, after clockBoot(), writing only the registers that differ
+void clockSetup(void);
+// Carry the seconds count into minutes, hours and the date, re-reading the RTC in the background
+//  once a day or after clockResync()
+void clockUpdate(void);
+// Show 12 (true) or 24 hour time, keeping the RTC in the same mode
+void clockSet12Hour(bool on);
+// Whether the face's time is in the night
+bool clockIsNight(void);
+// Swap SQW on MFP for alarm 0, set for the end of the night; nonzero if the RTC didn't take it
+uint8_t clockNightBegin(void);
+// Put SQW back, clear the alarm and re-read the time, which stopped being counted for the night
+void clockNightEnd(void);
+// The count has gone wrong, e.g. a second was missed, so re-read the RTC at the next clockUpdate()
+void clockResync(void);
+// Seconds from the start of 2000 to a time read from the RTC
+uint32_t clockTimestamp(const mcp7940_time_t *time);
+// The hours as the face shows them, daylight saving time added and 1-12 with USE_12H
+uint8_t clockShownHours(void);
+
+#endif //__CLOCK_H__
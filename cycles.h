@@ -0,0 +1,22 @@
+#ifndef __CYCLES_H__
+#define __CYCLES_H__
+#include <stdint.h>
+#include <avr/io.h>
+
+// Timer1 free-running at clk/8, used to time sections of code
+// One count is 8 CPU cycles, so a section can be up to 524288 cycles (65 ms at 8 MHz) long
+#define CYCLES_PER_COUNT 8
+
+static inline void cycles_init(void)
+{
+	TCCR1A = 0;
+	TCCR1B = 1<<CS11;
+}
+
+// Take the difference of two readings and multiply by CYCLES_PER_COUNT to get cycles
+static inline uint16_t cycles_now(void)
+{
+	return TCNT1;
+}
+
+#endif // __CYCLES_H__
@@ -0,0 +1,668 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "display.h"
+#include "ws2812.h"
+#include "hsv_rgb.h"
+#include LAYOUT_GLYPHS
+#include "cycles.h"
+#include "frame.h"
+#include "effects.h"
+
+#if DISPLAY_MODE != DISPLAY_FRAMEBUFFER && (EFFECT != EFFECT_RAINBOW || TRANSITION != TRANSITION_NONE)
+#error "Only DISPLAY_FRAMEBUFFER has effects other than the rainbow, or transitions"
+#endif
+#if GLYPH_LEDS != LAYOUT_DIGIT_LEDS
+#error "LAYOUT_GLYPHS doesn't have LAYOUT_DIGIT_LEDS LEDs to a digit"
+#endif
+typedef char layoutFits[LAYOUT_LEDS == MAX_LED && SLOT_COUNT <= 8 ? 1 : -1];
+
+// The state of the rainbow, a position on the hsvToRGB hue wheel
+uint16_t state = 0;
+// How far the rainbow moves each second (whether in one step or spread over the frames), and how far apart neighbouring LEDs are on the wheel
+uint16_t hueStep = HUE_DEGREES(HUE_STEP_DEGREES);
+// How bright the face is, 0-255 before the dim curve
+uint8_t brightness = BRIGHTNESS;
+// The part of a wheel step the per-frame animation has built up, in 1/FRAME_RATE steps
+uint16_t animationRemainder = 0;
+// Frames the animation has moved on by, wrapping; a whole second's worth for each stepAnimation()
+uint8_t animationFrames = 0;
+// Which of effects[] colours the face
+uint8_t effect = EFFECT;
+// How a slot goes from one value to the next
+uint8_t transition = TRANSITION;
+// reserving a byte for loop variant
+uint8_t curLed;
+// To be used for each digit to walk its list of lit LEDs
+uint8_t temp0;
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+uint8_t colors[MAX_LED][3];
+// The channel steps each slot adds up to, kept as it is rendered
+uint16_t slotSteps[SLOT_COUNT];
+// The framebuffer holds dimmed colours, so nothing in it can be reused
+bool limited = false;
+// The current effect's hooks, copied out of flash so the per-LED call is a plain indirect call
+void (*frameHook)(void);
+void (*pixelHook)(uint8_t led, uint8_t rgb[3]);
+uint8_t effectFlags;
+#elif DISPLAY_MODE == DISPLAY_STREAM
+// The per-frame plan for streaming: one bit per LED saying whether it is lit,
+//  and the rising edge of the hue wheel at the display's brightness in 64 steps
+//  (the falling edge is the same table read backwards)
+uint8_t litMask[(MAX_LED+7)/8];
+uint8_t ramp[64];
+// The top of the ramp, and the brightness the ramp was built for
+uint8_t rampPeak;
+uint8_t rampVal;
+// How many LEDs are lit, and the channel steps one lit LED adds up to on average
+uint8_t litCount;
+uint16_t rampSteps;
+// The factor the ramp has been dimmed by, 255 being not at all
+uint8_t rampScale = 255;
+#elif DISPLAY_MODE == DISPLAY_PALETTE
+// One palette index per LED, 0 being off
+uint8_t pixels[MAX_LED];
+// The palette, split by channel so the flush can index it directly
+uint8_t paletteR[PALETTE_SIZE];
+uint8_t paletteG[PALETTE_SIZE];
+uint8_t paletteB[PALETTE_SIZE];
+// The rainbow state the palette was last built for
+uint16_t paletteState = 0xFFFF;
+// How many LEDs use each palette entry
+uint8_t bandCount[PALETTE_SIZE] = {MAX_LED};
+// The palette has been dimmed to fit the power budget
+bool paletteDimmed = false;
+#endif
+
+// One bit per slot that must be recomputed before the next flush
+uint8_t dirtySlots = SLOT_ALL;
+// The digit (or colon on/off) each slot was last rendered with; 0xFF forces the first render
+#define SLOT_UNSET(name, kind, leds, wiring, value) 0xFF,
+uint8_t slotValue[SLOT_COUNT] = {LAYOUT_SLOTS(SLOT_UNSET)};
+// The slot being rendered, for effects that colour slots differently
+uint8_t curSlot;
+// The rainbow state the framebuffer was last rendered with
+uint16_t renderedState = 0xFFFF;
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+// One bit per slot that is part way from slotFrom to slotValue, and how far, 1-255 of the way
+uint8_t transitionSlots = 0;
+uint8_t slotFrom[SLOT_COUNT];
+uint8_t slotProgress[SLOT_COUNT];
+// Set by tickAnimation(), cleared by stepAnimation(): without a frame clock nothing would move a
+//  transition on until the next second, so none are started
+bool framePaced = false;
+#endif
+
+#if RENDER_STATS
+// Cycles each slot took the last time it was rendered
+uint32_t slotCycles[SLOT_COUNT];
+// Cycles the last flush to the LEDs took
+uint32_t flushCycles;
+volatile uint32_t cyclesSavedLastTick;
+volatile uint32_t cyclesSavedTotal;
+#endif
+
+// The channel steps (0-255 per channel) of the last frame sent, before any limiting
+uint32_t frameSteps;
+#if POWER_BUDGET_MA
+// What is left of the budget for the channels once every LED's idle current is taken off
+#define POWER_BUDGET_STEPS ((POWER_BUDGET_MA*1000UL - MAX_LED*(uint32_t)LED_IDLE_UA)/LED_UA_PER_STEP)
+#endif
+
+// The scale8() factor that brings a frame under the budget, 255 if it already fits
+// Only a frame that is over budget pays for the division
+static uint8_t powerScale(uint32_t steps) {
+#if POWER_BUDGET_MA
+  if(steps > POWER_BUDGET_STEPS) {
+    uint8_t scale = (POWER_BUDGET_STEPS<<8)/steps;
+    return scale ? scale-1 : 0;
+  }
+#endif
+  return 255;
+}
+
+uint16_t displayCurrentMA(void) {
+  return (frameSteps*LED_UA_PER_STEP + MAX_LED*(uint32_t)LED_IDLE_UA)/1000;
+}
+
+void stepAnimation(void) {
+  animationFrames += FRAME_RATE;
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+  framePaced = false;
+  dirtySlots |= transitionSlots;
+  transitionSlots = 0;
+#endif
+  state+=hueStep;
+  if(state >= HUE_MAX) {
+    state -= HUE_MAX;
+  }
+}
+
+void tickAnimation(uint8_t frames) {
+  animationFrames += frames;
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+  framePaced = true;
+  // Dropped frames move a transition on as well, so it still ends TRANSITION_MS after it started
+  for(uint8_t slot = 0; slot < SLOT_COUNT; slot++) {
+    if(transitionSlots & (1<<slot)) {
+      uint16_t progress = slotProgress[slot] + TRANSITION_STEP*(uint16_t)frames;
+      if(progress >= 255) {
+        transitionSlots &= ~(1<<slot);
+      }
+      slotProgress[slot] = progress;
+      dirtySlots |= 1<<slot;
+    }
+  }
+#endif
+  animationRemainder += hueStep*frames;
+  while(animationRemainder >= FRAME_RATE) {
+    animationRemainder -= FRAME_RATE;
+    state++;
+  }
+  if(state >= HUE_MAX) {
+    state -= HUE_MAX;
+  }
+}
+
+void invalidateDisplay(void) {
+  dirtySlots = SLOT_ALL;
+}
+
+void setBrightness(uint8_t value) {
+  if(value == brightness) {
+    return;
+  }
+  brightness = value;
+  // Like a step of the rainbow, every colour changes: the framebuffer is redrawn, the stream ramp and
+  //  the palette are rebuilt
+  renderedState = 0xFFFF;
+#if DISPLAY_MODE == DISPLAY_PALETTE
+  paletteState = 0xFFFF;
+#endif
+}
+
+void setHueStep(uint8_t degrees) {
+  hueStep = HUE_DEGREES(degrees);
+}
+
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+// The flush holds the CPU for 24 bits of 1.25us per LED, whatever the effect
+#define FLUSH_CYCLES (MAX_LED*30UL*(F_CPU/1000000UL))
+#define FRAME_BUDGET_CYCLES (FRAME_BUDGET_US*(F_CPU/1000000UL))
+
+uint32_t effectCost(uint8_t effectId, uint8_t transitionId) {
+  uint16_t pixelCycles = pgm_read_word(&effects[effectId].pixelCycles);
+  if(transitionId != TRANSITION_NONE) {
+    pixelCycles += TRANSITION_PIXEL_CYCLES;
+  }
+  return pgm_read_word(&effects[effectId].frameCycles) + (uint32_t)MAX_LED*pixelCycles + FLUSH_CYCLES;
+}
+
+// Whether a frame with every LED lit, and every slot part way through a transition, fits the budget
+static bool fits(uint8_t effectId, uint8_t transitionId) {
+  return effectCost(effectId, transitionId) <= FRAME_BUDGET_CYCLES;
+}
+
+bool effectFits(uint8_t id) {
+  return fits(id, transition);
+}
+
+static void loadEffect(uint8_t id) {
+  effect = id;
+  frameHook = (void (*)(void))pgm_read_ptr(&effects[id].frame);
+  pixelHook = (void (*)(uint8_t, uint8_t *))pgm_read_ptr(&effects[id].pixel);
+  effectFlags = pgm_read_byte(&effects[id].flags);
+  void (*init)(void) = (void (*)(void))pgm_read_ptr(&effects[id].init);
+  if(init) {
+    init();
+  }
+}
+
+bool setEffect(uint8_t id) {
+  if(id == effect) {
+    return true;
+  }
+  // The compiled-in effect is the builder's choice, so only a change at run time is held to the budget
+  if(id >= EFFECT_COUNT || (id != EFFECT && !effectFits(id))) {
+    return false;
+  }
+  loadEffect(id);
+  renderedState = 0xFFFF;
+  return true;
+}
+
+bool setTransition(uint8_t id) {
+  if(id == transition) {
+    return true;
+  }
+  if(id >= TRANSITION_COUNT || (id != TRANSITION && !fits(effect, id))) {
+    return false;
+  }
+  transition = id;
+  return true;
+}
+#else
+// The other modes only know how to draw the rainbow
+bool effectFits(uint8_t id) {
+  return id == EFFECT_RAINBOW;
+}
+
+bool setEffect(uint8_t id) {
+  return id == EFFECT_RAINBOW;
+}
+
+// The other modes have no colours of their own to blend
+bool setTransition(uint8_t id) {
+  return id == TRANSITION_NONE;
+}
+#endif
+
+// Mark a slot dirty if the value it shows has changed since it was last rendered
+static inline void markSlot(uint8_t slot, uint8_t value) {
+  if(slotValue[slot] != value) {
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+    // Start from what the slot was showing; a change part way through a transition cuts it short
+    //  rather than letting the face fall behind
+    if(transition != TRANSITION_NONE && framePaced && slotValue[slot] != 0xFF) {
+      slotFrom[slot] = slotValue[slot];
+      slotProgress[slot] = TRANSITION_STEP;
+      transitionSlots |= 1<<slot;
+    }
+#endif
+    slotValue[slot] = value;
+    dirtySlots |= 1<<slot;
+  }
+}
+
+// The LED an offset into a slot lands on, from where the slot starts and which way it is wired
+static inline uint8_t slotLed(uint8_t firstLed, uint8_t leds, uint8_t wiring, uint8_t offset) {
+  return wiring == LAYOUT_REVERSED ? firstLed + leds - 1 - offset : firstLed + offset;
+}
+
+// Whether the LED at offset in a slot is lit for a value
+static bool slotLit(uint8_t kind, uint8_t value, uint8_t offset) {
+  if(kind == LAYOUT_COLON) {
+    return value;
+  }
+  return pgm_read_byte(&glyph_bits[value][offset/8]) & (1<<(offset%8));
+}
+
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+// Render one LED with the effect and return the channel steps it adds up to
+static uint16_t renderLed(uint8_t led) {
+  pixelHook(led, colors[led]);
+  return colors[led][0] + colors[led][1] + colors[led][2];
+}
+
+// Render one digit, clearing it and then lighting only the LEDs the glyph uses
+static uint16_t renderDigit(uint8_t firstLed, uint8_t wiring, uint8_t value) {
+  uint16_t steps = 0;
+  uint8_t litEnd = pgm_read_byte(&glyph_lit_start[value+1]);
+  memset(colors[firstLed], 0, GLYPH_LEDS*3);
+  for(temp0 = pgm_read_byte(&glyph_lit_start[value]); temp0 < litEnd; temp0++) {
+    curLed = slotLed(firstLed, GLYPH_LEDS, wiring, pgm_read_byte(&glyph_lit[temp0]));
+    steps += renderLed(curLed);
+  }
+  return steps;
+}
+
+// Render the colon, which is either fully lit or fully dark
+static uint16_t renderColon(uint8_t firstLed, uint8_t leds, uint8_t lit) {
+  uint16_t steps = 0;
+  if(!lit) {
+    memset(colors[firstLed], 0, leds*3);
+    return 0;
+  }
+  for(curLed = firstLed; curLed < firstLed + leds; curLed++) {
+    steps += renderLed(curLed);
+  }
+  return steps;
+}
+
+// Where in a transition (out of 255) the LED at offset changes over, for the wipe and the dissolve
+static uint8_t switchPoint(uint8_t offset) {
+  if(transition == TRANSITION_WIPE) {
+    return offset*(256/GLYPH_LEDS);
+  }
+  // An 8 bit xorshift of the offset scatters the LEDs the same way every time
+  uint8_t point = offset + 1;
+  point ^= point<<3;
+  point ^= point>>5;
+  point ^= point<<4;
+  return point;
+}
+
+// Render every LED of a slot part way from slotFrom to slotValue
+// LEDs lit in both or neither are drawn as usual; the ones that change fade, or switch at their own point
+static uint16_t renderTransition(uint8_t slot, uint8_t firstLed, uint8_t leds, uint8_t kind, uint8_t wiring) {
+  uint16_t steps = 0;
+  uint8_t progress = slotProgress[slot];
+  for(temp0 = 0; temp0 < leds; temp0++) {
+    curLed = slotLed(firstLed, leds, wiring, temp0);
+    bool from = slotLit(kind, slotFrom[slot], temp0);
+    bool to = slotLit(kind, slotValue[slot], temp0);
+    uint8_t weight = to ? 255 : 0;
+    if(from != to) {
+      if(transition == TRANSITION_CROSSFADE) {
+        weight = to ? progress : 255 - progress;
+      } else if(progress < switchPoint(temp0)) {
+        weight = from ? 255 : 0;
+      }
+    }
+    if(!weight) {
+      memset(colors[curLed], 0, 3);
+      continue;
+    }
+    pixelHook(curLed, colors[curLed]);
+    if(weight != 255) {
+      colors[curLed][0] = scale8(colors[curLed][0], weight);
+      colors[curLed][1] = scale8(colors[curLed][1], weight);
+      colors[curLed][2] = scale8(colors[curLed][2], weight);
+    }
+    steps += colors[curLed][0] + colors[curLed][1] + colors[curLed][2];
+  }
+  return steps;
+}
+
+// Recompute one slot's LEDs in the framebuffer
+static void renderSlotLeds(uint8_t slot, uint8_t firstLed, uint8_t leds, uint8_t kind, uint8_t wiring) {
+  if(transitionSlots & (1<<slot)) {
+    slotSteps[slot] = renderTransition(slot, firstLed, leds, kind, wiring);
+  } else if(kind == LAYOUT_COLON) {
+    slotSteps[slot] = renderColon(firstLed, leds, slotValue[slot]);
+  } else {
+    slotSteps[slot] = renderDigit(firstLed, wiring, slotValue[slot]);
+  }
+}
+
+// Add up the frame from the slot totals and dim the framebuffer in place if it is over budget
+// The dimmed colours can't be reused, so the next frame that changes anything redraws every slot
+static void limitPower(void) {
+  frameSteps = 0;
+  for(temp0 = 0; temp0 < SLOT_COUNT; temp0++) {
+    frameSteps += slotSteps[temp0];
+  }
+  uint8_t scale = powerScale(frameSteps);
+  limited = scale != 255;
+  if(!limited) {
+    return;
+  }
+  uint8_t *channel = colors[0];
+  for(uint16_t i = 0; i < MAX_LED*3; i++, channel++) {
+    *channel = scale8(*channel, scale);
+  }
+}
+#elif DISPLAY_MODE == DISPLAY_STREAM
+// Copy one slot's lit LEDs into the mask; the colon is all on or all off
+static void renderSlotLeds(uint8_t slot, uint8_t firstLed, uint8_t leds, uint8_t kind, uint8_t wiring) {
+  uint8_t value = slotValue[slot];
+  for(temp0 = 0; temp0 < leds; temp0++) {
+    bool lit = slotLit(kind, value, temp0);
+    curLed = slotLed(firstLed, leds, wiring, temp0);
+    uint8_t *maskByte = &litMask[curLed/8];
+    uint8_t bit = 1<<(curLed%8);
+    if(lit && !(*maskByte & bit)) {
+      *maskByte |= bit;
+      litCount++;
+    } else if(!lit && (*maskByte & bit)) {
+      *maskByte &= ~bit;
+      litCount--;
+    }
+  }
+}
+
+// Build the ramp for a new brightness, using sector 0 of hsvToRGB where green rises and red is at the peak
+static void buildRamp(uint8_t val) {
+  uint8_t rgb[3];
+  uint16_t rampTotal = 0;
+  for(temp0 = 0; temp0 < 64; temp0++) {
+    hsvToRGB((temp0<<2) + 2, 255, val, rgb);
+    ramp[temp0] = rgb[1];
+    rampTotal += rgb[1];
+  }
+  rampPeak = rgb[0];
+  rampVal = val;
+  rampScale = 255;
+  // A lit LED always has one channel at the peak, one on the ramp and one off
+  rampSteps = rampPeak + rampTotal/64;
+}
+
+// Estimate the frame from the lit count and dim the ramp if it is over budget
+// The ramp is only rebuilt when the factor changes, not every limited frame
+static void limitPower(void) {
+  if(rampVal != brightness) {
+    buildRamp(brightness);
+  }
+  frameSteps = (uint32_t)litCount * rampSteps;
+  uint8_t scale = powerScale(frameSteps);
+  if(scale == rampScale) {
+    return;
+  }
+  if(rampScale != 255) {
+    buildRamp(brightness);
+  }
+  for(temp0 = 0; temp0 < 64; temp0++) {
+    ramp[temp0] = scale8(ramp[temp0], scale);
+  }
+  rampPeak = scale8(rampPeak, scale);
+  rampScale = scale;
+}
+#elif DISPLAY_MODE == DISPLAY_PALETTE
+// The palette entry for an LED: which band of the wheel its offset from the rainbow state falls in
+static uint8_t ledBand(uint8_t led) {
+  uint16_t offset = HUE_PER_LED*led;
+  while(offset >= HUE_MAX) {
+    offset -= HUE_MAX;
+  }
+  return (offset>>PALETTE_SHIFT) + 1;
+}
+
+// Set one slot's palette indices; since each LED's band is fixed, only a digit change gets here
+static void renderSlotLeds(uint8_t slot, uint8_t firstLed, uint8_t leds, uint8_t kind, uint8_t wiring) {
+  uint8_t value = slotValue[slot];
+  for(curLed = firstLed; curLed < firstLed + leds; curLed++) {
+    bandCount[pixels[curLed]]--;
+    pixels[curLed] = kind == LAYOUT_COLON && value ? ledBand(curLed) : 0;
+    bandCount[pixels[curLed]]++;
+  }
+  if(kind == LAYOUT_COLON) {
+    return;
+  }
+  uint8_t litEnd = pgm_read_byte(&glyph_lit_start[value+1]);
+  for(temp0 = pgm_read_byte(&glyph_lit_start[value]); temp0 < litEnd; temp0++) {
+    curLed = slotLed(firstLed, leds, wiring, pgm_read_byte(&glyph_lit[temp0]));
+    bandCount[0]--;
+    pixels[curLed] = ledBand(curLed);
+    bandCount[pixels[curLed]]++;
+  }
+}
+
+// One hsvToRGB per band, at the middle of the band
+static void buildPalette(void) {
+  uint8_t rgb[3];
+  uint16_t hue = state + (1<<(PALETTE_SHIFT-1));
+  for(temp0 = 1; temp0 < PALETTE_SIZE; temp0++) {
+    hsvToRGB(hue, 255, brightness, rgb);
+    paletteR[temp0] = rgb[0];
+    paletteG[temp0] = rgb[1];
+    paletteB[temp0] = rgb[2];
+    hue += 1<<PALETTE_SHIFT;
+  }
+  paletteState = state;
+  paletteDimmed = false;
+}
+
+// Estimate the frame from how many LEDs use each entry and dim the palette if it is over budget
+// A dimmed palette is rebuilt on the next frame so the estimate always starts from the real colours
+static void limitPower(void) {
+  if(paletteState != state || paletteDimmed) {
+    buildPalette();
+  }
+  frameSteps = 0;
+  for(temp0 = 1; temp0 < PALETTE_SIZE; temp0++) {
+    if(bandCount[temp0]) {
+      frameSteps += (uint32_t)bandCount[temp0] * (uint16_t)(paletteR[temp0] + paletteG[temp0] + paletteB[temp0]);
+    }
+  }
+  uint8_t scale = powerScale(frameSteps);
+  if(scale == 255) {
+    return;
+  }
+  for(temp0 = 1; temp0 < PALETTE_SIZE; temp0++) {
+    paletteR[temp0] = scale8(paletteR[temp0], scale);
+    paletteG[temp0] = scale8(paletteG[temp0], scale);
+    paletteB[temp0] = scale8(paletteB[temp0], scale);
+  }
+  paletteDimmed = true;
+}
+#endif
+
+// One case per slot of the layout, so each slot's first LED, size, kind and wiring are constants
+static void renderSlot(uint8_t slot) {
+  curSlot = slot;
+  switch(slot) {
+#define RENDER_SLOT(name, kind, leds, wiring, value) \
+    case SLOT_##name: renderSlotLeds(slot, LED_##name, leds, kind, wiring); break;
+    LAYOUT_SLOTS(RENDER_SLOT)
+  }
+}
+
+void updateDisplay(uint8_t hours, uint8_t minutes, uint8_t seconds, bool colon) {
+  bool resend = false;
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+  if(!pixelHook) {
+    loadEffect(effect);
+  }
+  // Every effect colours from the animation, so any change in it redraws everything
+  if(state != renderedState || (effectFlags & EFFECT_ANIMATED)) {
+#else
+  // The rainbow shifts every pixel, so any change in the animation redraws everything
+  if(state != renderedState) {
+#endif
+    renderedState = state;
+    resend = true;
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+    dirtySlots = SLOT_ALL;
+#endif
+    // The other modes only need the colours (the plan or the palette) rebuilt, which the flush does
+  }
+#define MARK_SLOT(name, kind, leds, wiring, value) markSlot(SLOT_##name, value);
+  LAYOUT_SLOTS(MARK_SLOT)
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+  if(limited && dirtySlots) {
+    dirtySlots = SLOT_ALL;
+  }
+  if(dirtySlots) {
+    frameHook();
+  }
+#endif
+
+#if RENDER_STATS
+  uint16_t started;
+  cyclesSavedLastTick = 0;
+#endif
+  for(uint8_t slot = 0; slot < SLOT_COUNT; slot++) {
+    if(!(dirtySlots & (1<<slot))) {
+#if RENDER_STATS
+      cyclesSavedLastTick += slotCycles[slot];
+#endif
+      continue;
+    }
+#if RENDER_STATS
+    started = cycles_now();
+#endif
+    renderSlot(slot);
+#if RENDER_STATS
+    slotCycles[slot] = (uint16_t)(cycles_now() - started) * (uint32_t)CYCLES_PER_COUNT;
+#endif
+  }
+  // Nothing changed since the last frame we sent, so the LEDs are already showing it
+  if(!dirtySlots && !resend) {
+#if RENDER_STATS
+    cyclesSavedLastTick += flushCycles;
+    cyclesSavedTotal += cyclesSavedLastTick;
+#endif
+    return;
+  }
+  dirtySlots = 0;
+
+#if RENDER_STATS
+  started = cycles_now();
+#endif
+  limitPower();
+  flushDisplay();
+#if RENDER_STATS
+  flushCycles = (uint16_t)(cycles_now() - started) * (uint32_t)CYCLES_PER_COUNT;
+  cyclesSavedTotal += cyclesSavedLastTick;
+#endif
+}
+
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+void flushDisplay(void) {
+  ws2812_frame_begin();
+  for(curLed = 0; curLed < MAX_LED; curLed++) {
+    ws2812_set_single(colors[curLed][0],colors[curLed][1],colors[curLed][2]);
+  }
+  ws2812_frame_end();
+}
+#elif DISPLAY_MODE == DISPLAY_STREAM
+void flushDisplay(void) {
+  if(rampVal != brightness) {
+    buildRamp(brightness);
+  }
+  uint16_t hue = state;
+  const uint8_t *maskByte = litMask;
+  uint8_t bits = 0;
+  uint8_t bit = 0;
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+  ws2812_frame_begin();
+  // Everything between two ws2812_set_single() calls happens with the line held low
+  // That gap has to stay under WS2812_TLOW_MAX_NS or the LEDs latch mid-frame; bench_gap_stream reports the
+  //  longest one as stream.flush.gap_max, and stream.flush.gap_over_limit is 0 while it fits
+  for(curLed = 0; curLed < MAX_LED; curLed++) {
+    if(!bit) {
+      bits = *maskByte++;
+      bit = 1;
+    }
+    r = 0;
+    g = 0;
+    b = 0;
+    if(bits & bit) {
+      uint8_t step = ((uint8_t)hue)>>2;
+      uint8_t rise = ramp[step];
+      uint8_t fall = ramp[63-step];
+      switch(hue>>8) {
+        case 0: r = rampPeak; g = rise; break;
+        case 1: r = fall; g = rampPeak; break;
+        case 2: g = rampPeak; b = rise; break;
+        case 3: g = fall; b = rampPeak; break;
+        case 4: r = rise; b = rampPeak; break;
+        default: r = rampPeak; b = fall; break;
+      }
+    }
+    ws2812_set_single(r, g, b);
+    bit <<= 1;
+    hue += HUE_PER_LED;
+    if(hue >= HUE_MAX) {
+      hue -= HUE_MAX;
+    }
+  }
+  ws2812_frame_end();
+}
+#elif DISPLAY_MODE == DISPLAY_PALETTE
+void flushDisplay(void) {
+  if(paletteState != state) {
+    buildPalette();
+  }
+  uint8_t index;
+  ws2812_frame_begin();
+  for(curLed = 0; curLed < MAX_LED; curLed++) {
+    index = pixels[curLed];
+    ws2812_set_single(paletteR[index], paletteG[index], paletteB[index]);
+  }
+  ws2812_frame_end();
+}
+#endif
@@ -0,0 +1,141 @@
+#ifndef __DISPLAY_H__
+#define __DISPLAY_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include "hsv_rgb.h"
+#include "layout.h"
+#include "frame.h"
+
+// How the face gets to the LEDs
+//  DISPLAY_FRAMEBUFFER: render into colors[], 3 bytes per LED, and only recompute what changed
+//  DISPLAY_STREAM: no framebuffer, each LED's colour is worked out just before it is sent
+//   from a per-frame plan (a lit bit per LED and a 64 entry hue ramp, 80 bytes in all)
+//  DISPLAY_PALETTE: one palette index per LED, with the rainbow cut into bands of the hue wheel
+//   so only one hsvToRGB per band is needed each frame; the flush looks the colours up as it sends
+#define DISPLAY_FRAMEBUFFER 0
+#define DISPLAY_STREAM 1
+#define DISPLAY_PALETTE 2
+#ifndef DISPLAY_MODE
+#define DISPLAY_MODE DISPLAY_FRAMEBUFFER
+#endif
+
+// DISPLAY_PALETTE: each band is 1<<PALETTE_SHIFT steps of the hue wheel, so 6 gives 24 bands of 15 degrees
+// Entry 0 of the palette is off
+#ifndef PALETTE_SHIFT
+#define PALETTE_SHIFT 6
+#endif
+#define PALETTE_SIZE ((HUE_MAX>>PALETTE_SHIFT)+1)
+
+// How bright the face is at first, 0-255 before the dim curve
+#ifndef BRIGHTNESS
+#define BRIGHTNESS 50
+#endif
+// How far the rainbow moves each second at first, in degrees
+#ifndef HUE_STEP_DEGREES
+#define HUE_STEP_DEGREES 5
+#endif
+// How far apart neighbouring LEDs are on the hue wheel in the rainbow
+#define HUE_PER_LED HUE_DEGREES(3)
+
+// How a slot goes from one digit to the next (DISPLAY_FRAMEBUFFER only, the other modes always snap)
+//  TRANSITION_NONE: at once
+//  TRANSITION_CROSSFADE: the LEDs going out fade down while the ones coming on fade up
+//  TRANSITION_WIPE: the LEDs change over one after another, in the order the digit is wired
+//  TRANSITION_DISSOLVE: the LEDs change over one by one in a scattered order
+#define TRANSITION_NONE 0
+#define TRANSITION_CROSSFADE 1
+#define TRANSITION_WIPE 2
+#define TRANSITION_DISSOLVE 3
+#define TRANSITION_COUNT 4
+#ifndef TRANSITION
+#define TRANSITION TRANSITION_NONE
+#endif
+// How long a transition takes; it has to be over before the seconds change again
+#ifndef TRANSITION_MS
+#define TRANSITION_MS 500
+#endif
+#if TRANSITION_MS >= 1000
+#error "TRANSITION_MS must be under a second"
+#endif
+// At least a frame long, or TRANSITION_STEP would not fit the byte the progress is kept in
+#if TRANSITION_MS*FRAME_RATE < 1000
+#error "TRANSITION_MS must be at least one frame, 1000/FRAME_RATE"
+#endif
+// How far through a transition (out of 255) each frame goes, rounded up so it is never late
+#define TRANSITION_STEP ((255000UL + (uint32_t)TRANSITION_MS*FRAME_RATE - 1)/((uint32_t)TRANSITION_MS*FRAME_RATE))
+// What a transition adds to each LED of a slot in one, on top of the effect: the glyph lookups and three scale8()
+#define TRANSITION_PIXEL_CYCLES 350
+
+// Every slot, for the dirty mask (the slots themselves are described in layout.h)
+#define SLOT_ALL ((1<<SLOT_COUNT)-1)
+
+// 1: Measure how many cycles the dirty tracking saves, using Timer1 (see cycles.h)
+// 0: No measurement
+#ifndef RENDER_STATS
+#define RENDER_STATS 0
+#endif
+#if RENDER_STATS
+// Cycles skipped during the most recent updateDisplay(), and since boot
+extern volatile uint32_t cyclesSavedLastTick;
+extern volatile uint32_t cyclesSavedTotal;
+#endif
+
+// The LED current budget, in mA; a frame that would draw more is dimmed evenly to fit
+// 0 turns the limiter off
+#ifndef POWER_BUDGET_MA
+#define POWER_BUDGET_MA 450
+#endif
+// What one colour channel draws per step of its 0-255 value, in uA (about 20mA at full on a WS2812B)
+#ifndef LED_UA_PER_STEP
+#define LED_UA_PER_STEP 78
+#endif
+// What each LED draws with all three channels off, in uA
+#ifndef LED_IDLE_UA
+#define LED_IDLE_UA 1000
+#endif
+#if POWER_BUDGET_MA && (POWER_BUDGET_MA*1000UL <= MAX_LED*LED_IDLE_UA*1UL)
+#error "POWER_BUDGET_MA does not even cover the LEDs' idle current"
+#endif
+
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER && MAX_LED > 128
+#error "More than 128 LEDs leaves too little SRAM for DISPLAY_FRAMEBUFFER; use DISPLAY_STREAM or DISPLAY_PALETTE"
+#endif
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+// reserving 3*(leds) bytes for keeping the data easily accessible
+extern uint8_t colors[MAX_LED][3];
+#endif
+
+// Move the rainbow along by one step; the next updateDisplay() redraws everything
+void stepAnimation(void);
+// Move the rainbow along by that many frames' worth of its per-second step, for smooth animation
+void tickAnimation(uint8_t frames);
+// Force every slot to be redrawn and sent on the next updateDisplay()
+void invalidateDisplay(void);
+// Change the brightness (0-255 before the dim curve); the next updateDisplay() redraws everything
+void setBrightness(uint8_t value);
+// Change how far the rainbow moves each second, in degrees
+void setHueStep(uint8_t degrees);
+// Which effect colours the face
+extern uint8_t effect;
+// How slots go from one value to the next
+extern uint8_t transition;
+// Change the transition; false, leaving it as it was, if there is no such transition, this DISPLAY_MODE
+//  can't draw it or the effect with it doesn't fit the frame budget
+bool setTransition(uint8_t id);
+// Whether an effect (EFFECT_ in effects.h) can draw a frame with every LED lit within FRAME_BUDGET_US
+bool effectFits(uint8_t id);
+// DISPLAY_FRAMEBUFFER: the cycles a frame with every LED lit takes with an effect and a transition, flush
+//  included, going by the costs the effect declares; what effectFits() holds to the budget
+uint32_t effectCost(uint8_t effectId, uint8_t transitionId);
+// Colour the face with another effect; false, leaving it as it was, if there is no such effect,
+//  this DISPLAY_MODE can't draw it or it doesn't fit the frame budget
+bool setEffect(uint8_t id);
+// Redraw whatever changed since the last call and send it to the LEDs
+// Does nothing (not even the flush) when the face would look the same
+void updateDisplay(uint8_t hours, uint8_t minutes, uint8_t seconds, bool colon);
+// The estimated current of the last frame sent, in mA, before any limiting
+uint16_t displayCurrentMA(void);
+// Send the whole face to the LEDs (with interrupts off for the bit-banged WS2812 back end)
+void flushDisplay(void);
+
+#endif //__DISPLAY_H__
@@ -0,0 +1,98 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "effects.h"
+#include "display.h"
+#include "hsv_rgb.h"
+
+#if DISPLAY_MODE == DISPLAY_FRAMEBUFFER
+// The colour every lit LED shares this frame (EFFECT_DIGITS: the colour of the slot last asked for)
+static uint8_t color[3];
+
+// EFFECT_RAINBOW
+// Each slot's lit LEDs come in order (backwards in a reversed slot), so the next LED's hue is a few
+//  additions or subtractions on from the last one's rather than a multiply, which this core does in software
+static uint8_t rainbowLed;
+static uint16_t rainbowHue;
+
+static void rainbowFrame(void) {
+  rainbowLed = 0;
+  rainbowHue = state;
+}
+
+static void rainbowPixel(uint8_t led, uint8_t rgb[3]) {
+  while(rainbowLed < led) {
+    rainbowLed++;
+    rainbowHue += HUE_PER_LED;
+  }
+  while(rainbowLed > led) {
+    rainbowLed--;
+    rainbowHue -= HUE_PER_LED;
+  }
+  hsvToRGB(rainbowHue, 255, brightness, rgb);
+}
+
+// EFFECT_SOLID, and the base colour of EFFECT_SPARKLE
+static void solidFrame(void) {
+  hsvToRGB(state, 255, brightness, color);
+}
+
+static void solidPixel(uint8_t led, uint8_t rgb[3]) {
+  memcpy(rgb, color, 3);
+}
+
+// EFFECT_BREATHE: a triangle wave between a quarter and all of the brightness
+static void breatheFrame(void) {
+  uint8_t phase = animationFrames*BREATHE_STEP;
+  uint8_t level = phase < 128 ? phase<<1 : (255-phase)<<1;
+  hsvToRGB(state, 255, scale8(brightness, 64 + scale8(level, 191)), color);
+}
+
+// EFFECT_DIGITS
+// The slot color[] was worked out for, 0xFF for none yet this frame
+static uint8_t digitsSlot;
+
+static void digitsFrame(void) {
+  digitsSlot = 0xFF;
+}
+
+static void digitsPixel(uint8_t led, uint8_t rgb[3]) {
+  if(curSlot != digitsSlot) {
+    digitsSlot = curSlot;
+    hsvToRGB(state + curSlot*(HUE_MAX/SLOT_COUNT), 255, brightness, color);
+  }
+  memcpy(rgb, color, 3);
+}
+
+// EFFECT_SPARKLE
+static uint8_t white[3];
+// An 8 bit xorshift, never 0
+static uint8_t sparkleRandom;
+
+static void sparkleInit(void) {
+  sparkleRandom = (uint8_t)state | 1;
+}
+
+static void sparkleFrame(void) {
+  solidFrame();
+  hsvToRGB(0, 0, brightness, white);
+}
+
+static void sparklePixel(uint8_t led, uint8_t rgb[3]) {
+  sparkleRandom ^= sparkleRandom<<3;
+  sparkleRandom ^= sparkleRandom>>5;
+  sparkleRandom ^= sparkleRandom<<4;
+  memcpy(rgb, sparkleRandom < SPARKLE_CHANCE ? white : color, 3);
+}
+
+// EFFECT_DIGITS does its (at most SLOT_COUNT) hsvToRGB calls from pixel(), so they are counted in frameCycles
+const effect_t effects[EFFECT_COUNT] PROGMEM = {
+  [EFFECT_RAINBOW] = {NULL, rainbowFrame, rainbowPixel, 20, 420, 0},
+  [EFFECT_SOLID] = {NULL, solidFrame, solidPixel, 400, 30, 0},
+  [EFFECT_BREATHE] = {NULL, breatheFrame, solidPixel, 600, 30, EFFECT_ANIMATED},
+  [EFFECT_DIGITS] = {NULL, digitsFrame, digitsPixel, 3200, 60, 0},
+  [EFFECT_SPARKLE] = {sparkleInit, sparkleFrame, sparklePixel, 800, 60, EFFECT_ANIMATED},
+};
+#endif
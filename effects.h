@@ -0,0 +1,67 @@
+#ifndef __EFFECTS_H__
+#define __EFFECTS_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+
+// The digits decide which LEDs are lit, the effect what colour each lit LED is
+// Only DISPLAY_FRAMEBUFFER has a choice; the other modes are built around the rainbow
+#define EFFECT_RAINBOW 0
+// The whole face one colour, moving round the wheel at the rainbow's speed
+#define EFFECT_SOLID 1
+// One colour like EFFECT_SOLID, slowly getting brighter and dimmer
+#define EFFECT_BREATHE 2
+// Each digit its own colour, spread evenly round the wheel
+#define EFFECT_DIGITS 3
+// One colour with a few LEDs flashing white each frame
+#define EFFECT_SPARKLE 4
+#define EFFECT_COUNT 5
+// The effect at power on, until the settings say otherwise
+#ifndef EFFECT
+#define EFFECT EFFECT_RAINBOW
+#endif
+#if EFFECT >= EFFECT_COUNT
+#error "EFFECT is not one of the EFFECT_ values"
+#endif
+
+// EFFECT_BREATHE: how far through a breath each frame goes, out of 256
+#ifndef BREATHE_STEP
+#define BREATHE_STEP 2
+#endif
+// EFFECT_SPARKLE: how many lit LEDs in 256 flash each frame
+#ifndef SPARKLE_CHANCE
+#define SPARKLE_CHANCE 8
+#endif
+
+// effect_t.flags: the colours change every frame on their own, so the whole face is redrawn each frame
+#define EFFECT_ANIMATED 0x01
+
+typedef struct {
+  // When the effect is chosen, or NULL
+  void (*init)(void);
+  // Before the lit LEDs of a frame are coloured
+  void (*frame)(void);
+  // The colour of one lit LED, called for each LED of every slot being redrawn
+  void (*pixel)(uint8_t led, uint8_t rgb[3]);
+  // Worst case cycles of one frame() and one pixel() on the attiny88, estimated from the code
+  // setEffect() turns down an effect whose frame with every LED lit doesn't fit FRAME_BUDGET_US
+  // bench_display confirms them: effect.<name>.over_declared is how far its measured frame ran past the
+  //  effectCost() (display.h) these add up to, and has to stay 0
+  uint16_t frameCycles;
+  uint16_t pixelCycles;
+  uint8_t flags;
+} effect_t;
+
+extern const effect_t effects[EFFECT_COUNT] PROGMEM;
+
+// The display's animation, which the effects take their colours from
+// A position on the hue wheel, moving at the speed setting
+extern uint16_t state;
+// 0-255 before the dim curve
+extern uint8_t brightness;
+// Frames drawn since power on, wrapping
+extern uint8_t animationFrames;
+// The slot (SLOT_ in layout.h) whose LEDs are being coloured
+extern uint8_t curSlot;
+
+#endif //__EFFECTS_H__
@@ -0,0 +1,104 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "frame.h"
+
+volatile uint16_t millis = 0;
+// Counts FRAME_RATE every millisecond; each time it passes 1000 a frame is due
+// This keeps the average rate exact even though 1000/FRAME_RATE is not a whole number of ms
+uint16_t frameClock = 0;
+volatile uint8_t framesDue = 0;
+
+uint16_t frameTimeUs = 0;
+uint16_t frameTimeMaxUs = 0;
+uint16_t frameOverruns = 0;
+uint16_t framesDropped = 0;
+// When the frame being drawn started
+uint16_t frameStartMs;
+uint8_t frameStartCount;
+
+static inline void tick(void) {
+  millis++;
+  frameClock += FRAME_RATE;
+  if(frameClock >= 1000) {
+    frameClock -= 1000;
+    if(framesDue < 255) {
+      framesDue++;
+    }
+  }
+}
+
+ISR(TIMER0_COMPA_vect) {
+  tick();
+}
+
+void frame_addTicks(uint8_t ticks) {
+  cli();
+  while(ticks--) {
+    tick();
+  }
+  sei();
+}
+
+void frame_init(void) {
+  OCR0A = TICK_COUNTS - 1;
+  TCNT0 = 0;
+  TIMSK0 = 1<<OCIE0A;
+  // On the tiny88 the CTC bit sits in TCCR0A next to the clock select
+  TCCR0A = 1<<CTC0 | TICK_CS;
+}
+
+uint16_t frame_millis(void) {
+  uint16_t now;
+  cli();
+  now = millis;
+  sei();
+  return now;
+}
+
+uint8_t frame_due(void) {
+  uint8_t due;
+  cli();
+  due = framesDue;
+  framesDue = 0;
+  sei();
+  if(due > 1) {
+    framesDropped += due - 1;
+  }
+  return due;
+}
+
+uint8_t frame_pending(void) {
+  return framesDue;
+}
+
+// Read the tick and the timer together; a compare that has happened but not been serviced yet counts
+static void frame_now(uint16_t *ms, uint8_t *count) {
+  cli();
+  *count = TCNT0;
+  *ms = millis;
+  if(TIFR0 & (1<<OCF0A)) {
+    *count = TCNT0;
+    (*ms)++;
+  }
+  sei();
+}
+
+void frame_begin(void) {
+  frame_now(&frameStartMs, &frameStartCount);
+}
+
+void frame_end(void) {
+  uint16_t ms;
+  uint8_t count;
+  frame_now(&ms, &count);
+  uint32_t elapsed = (uint32_t)(uint16_t)(ms - frameStartMs)*TICK_COUNTS + count - frameStartCount;
+  elapsed *= TICK_US_PER_COUNT;
+  frameTimeUs = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+  if(frameTimeUs > frameTimeMaxUs) {
+    frameTimeMaxUs = frameTimeUs;
+  }
+  if(frameTimeUs > FRAME_BUDGET_US) {
+    frameOverruns++;
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef __FRAME_H__
+#define __FRAME_H__
+#include <stdint.h>
+
+// Frames drawn per second, paced by Timer0
+#ifndef FRAME_RATE
+#define FRAME_RATE 30
+#endif
+#if FRAME_RATE < 30 || FRAME_RATE > 60
+#error "FRAME_RATE must be between 30 and 60"
+#endif
+// How long one frame may take, render and flush together
+#define FRAME_BUDGET_US (1000000UL/FRAME_RATE)
+
+// Timer0 in CTC mode interrupts once a millisecond
+// 8MHz/64 gives a whole number of counts; other clocks (4MHz is 62.5) get the nearest
+#define TICK_PRESCALE 64
+#define TICK_CS (1<<CS01 | 1<<CS00)
+#define TICK_COUNTS ((F_CPU/TICK_PRESCALE + 500)/1000)
+#define TICK_US_PER_COUNT (TICK_PRESCALE*1000000UL/F_CPU)
+#if TICK_COUNTS > 256
+#error "The 1ms tick does not fit in Timer0 at this F_CPU"
+#endif
+
+// How long the last frame took, and the longest since boot, in us
+extern uint16_t frameTimeUs;
+extern uint16_t frameTimeMaxUs;
+// Frames that took longer than FRAME_BUDGET_US
+extern uint16_t frameOverruns;
+// Frames skipped because the one before was still being drawn when they were due
+extern uint16_t framesDropped;
+
+// Start the 1ms tick and the frame clock
+void frame_init(void);
+// Milliseconds since frame_init(), wrapping every 65 seconds
+uint16_t frame_millis(void);
+// The count behind frame_millis(), for interrupt handlers to read directly
+// The tick stops in power-down, so it only counts time spent awake or idle
+extern volatile uint16_t millis;
+// How many frame periods have passed since the last call, 0 if no frame is due yet
+// More than 1 means frames were dropped; the caller should draw once and move the animation on by all of them
+uint8_t frame_due(void);
+// Whether a frame is due, without taking it; safe to call with interrupts off
+uint8_t frame_pending(void);
+// Run the tick for compares that came while its interrupt was masked (the SPI LED flush)
+void frame_addTicks(uint8_t ticks);
+// Bracket the render and flush of a frame to time it
+void frame_begin(void);
+void frame_end(void);
+
+#endif //__FRAME_H__
@@ -0,0 +1,40 @@
+// Generated by tools/glyphgen from glyphs.txt, do not edit
+#ifndef __GLYPHS_H__
+#define __GLYPHS_H__
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+// LEDs in one digit
+#define GLYPH_LEDS 20
+// Bytes of packed bits per digit
+#define GLYPH_BYTES 3
+
+const uint8_t glyph_bits[10][GLYPH_BYTES] PROGMEM = {
+  {0xFF, 0xF9, 0x0F}, //0
+  {0x98, 0x61, 0x08}, //1
+  {0x9F, 0x9F, 0x0F}, //2
+  {0x9F, 0x6F, 0x0F}, //3
+  {0xF9, 0x6F, 0x08}, //4
+  {0x6F, 0x6F, 0x0F}, //5
+  {0x6F, 0xFF, 0x0F}, //6
+  {0x9F, 0x61, 0x08}, //7
+  {0xFF, 0xFF, 0x0F}, //8
+  {0xFF, 0x6F, 0x08}  //9
+};
+
+const uint8_t glyph_lit_start[11] PROGMEM = {0, 18, 25, 41, 57, 70, 86, 104, 114, 134, 149};
+
+const uint8_t glyph_lit[149] PROGMEM = {
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 11, 12, 13, 14, 15, 16, 17, 18, 19, //0
+  3, 4, 7, 8, 13, 14, 19, //1
+  0, 1, 2, 3, 4, 7, 8, 9, 10, 11, 12, 15, 16, 17, 18, 19, //2
+  0, 1, 2, 3, 4, 7, 8, 9, 10, 11, 13, 14, 16, 17, 18, 19, //3
+  0, 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 14, 19, //4
+  0, 1, 2, 3, 5, 6, 8, 9, 10, 11, 13, 14, 16, 17, 18, 19, //5
+  0, 1, 2, 3, 5, 6, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, //6
+  0, 1, 2, 3, 4, 7, 8, 13, 14, 19, //7
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, //8
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 14, 19, //9
+};
+
+#endif //__GLYPHS_H__
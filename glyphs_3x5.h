@@ -0,0 +1,40 @@
+// Generated by tools/glyphgen from glyphs_3x5.txt, do not edit
+#ifndef __GLYPHS_H__
+#define __GLYPHS_H__
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+// LEDs in one digit
+#define GLYPH_LEDS 15
+// Bytes of packed bits per digit
+#define GLYPH_BYTES 2
+
+const uint8_t glyph_bits[10][GLYPH_BYTES] PROGMEM = {
+  {0x6F, 0x7B}, //0
+  {0xB2, 0x74}, //1
+  {0xCF, 0x79}, //2
+  {0xCF, 0x73}, //3
+  {0xED, 0x43}, //4
+  {0xE7, 0x73}, //5
+  {0xE7, 0x7B}, //6
+  {0x0F, 0x43}, //7
+  {0xEF, 0x7B}, //8
+  {0xEF, 0x73}  //9
+};
+
+const uint8_t glyph_lit_start[11] PROGMEM = {0, 12, 20, 31, 42, 51, 62, 74, 81, 94, 106};
+
+const uint8_t glyph_lit[106] PROGMEM = {
+  0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 13, 14, //0
+  1, 4, 5, 7, 10, 12, 13, 14, //1
+  0, 1, 2, 3, 6, 7, 8, 11, 12, 13, 14, //2
+  0, 1, 2, 3, 6, 7, 8, 9, 12, 13, 14, //3
+  0, 2, 3, 5, 6, 7, 8, 9, 14, //4
+  0, 1, 2, 5, 6, 7, 8, 9, 12, 13, 14, //5
+  0, 1, 2, 5, 6, 7, 8, 9, 11, 12, 13, 14, //6
+  0, 1, 2, 3, 8, 9, 14, //7
+  0, 1, 2, 3, 5, 6, 7, 8, 9, 11, 12, 13, 14, //8
+  0, 1, 2, 3, 5, 6, 7, 8, 9, 12, 13, 14, //9
+};
+
+#endif //__GLYPHS_H__
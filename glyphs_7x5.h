@@ -0,0 +1,40 @@
+// Generated by tools/glyphgen from glyphs_7x5.txt, do not edit
+#ifndef __GLYPHS_H__
+#define __GLYPHS_H__
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+// LEDs in one digit
+#define GLYPH_LEDS 35
+// Bytes of packed bits per digit
+#define GLYPH_BYTES 5
+
+const uint8_t glyph_bits[10][GLYPH_BYTES] PROGMEM = {
+  {0x2E, 0xE6, 0x3A, 0xA3, 0x03}, //0
+  {0x84, 0x11, 0x42, 0x88, 0x03}, //1
+  {0x2E, 0x42, 0x41, 0xD0, 0x07}, //2
+  {0x5F, 0x10, 0x01, 0xA3, 0x03}, //3
+  {0xC8, 0x28, 0xF9, 0x05, 0x02}, //4
+  {0x1F, 0xBE, 0x00, 0xA3, 0x03}, //5
+  {0x0C, 0x05, 0x1F, 0xA3, 0x03}, //6
+  {0x3F, 0x20, 0x22, 0x90, 0x00}, //7
+  {0x2E, 0x46, 0x17, 0xA3, 0x03}, //8
+  {0x2E, 0xC6, 0x07, 0x85, 0x01}  //9
+};
+
+const uint8_t glyph_lit_start[11] PROGMEM = {0, 19, 29, 43, 57, 71, 88, 103, 114, 131, 146};
+
+const uint8_t glyph_lit[146] PROGMEM = {
+  1, 2, 3, 5, 9, 10, 13, 14, 15, 17, 19, 20, 21, 24, 25, 29, 31, 32, 33, //0
+  2, 7, 8, 12, 17, 22, 27, 31, 32, 33, //1
+  1, 2, 3, 5, 9, 14, 16, 22, 28, 30, 31, 32, 33, 34, //2
+  0, 1, 2, 3, 4, 6, 12, 16, 24, 25, 29, 31, 32, 33, //3
+  3, 6, 7, 11, 13, 16, 19, 20, 21, 22, 23, 24, 26, 33, //4
+  0, 1, 2, 3, 4, 9, 10, 11, 12, 13, 15, 24, 25, 29, 31, 32, 33, //5
+  2, 3, 8, 10, 16, 17, 18, 19, 20, 24, 25, 29, 31, 32, 33, //6
+  0, 1, 2, 3, 4, 5, 13, 17, 21, 28, 31, //7
+  1, 2, 3, 5, 9, 10, 14, 16, 17, 18, 20, 24, 25, 29, 31, 32, 33, //8
+  1, 2, 3, 5, 9, 10, 14, 15, 16, 17, 18, 24, 26, 31, 32, //9
+};
+
+#endif //__GLYPHS_H__
@@ -0,0 +1,216 @@
+// Native build of the RTC driver against sim/mcp7940_model.c
+// Prints the bus traffic of each mcp7940_* call and of the boot sequence as "bench,<name>,<value>,<unit>" lines
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../mcp7940_tiny.h"
+#include "../clock.h"
+#include "../trim.h"
+#include "../sim/mcp7940_model.h"
+
+// The bus time the traffic since the last report took, in us
+static unsigned long busUs(void) {
+  return mcp7940_model_busBits()*1000000UL/mcp7940_model_scl;
+}
+
+static void report(const char *name) {
+  printf("bench,rtc.%s,%u,transactions\n", name, mcp7940_model_stats.transactions);
+  printf("bench,rtc.%s,%u,starts\n", name, mcp7940_model_stats.starts);
+  printf("bench,rtc.%s,%u,bytes\n", name, mcp7940_model_stats.bytes);
+  printf("bench,rtc.%s,%lu,us\n", name, busUs());
+  mcp7940_model_resetStats();
+}
+
+int main(void) {
+  i2c_init();
+  mcp7940_model_reset();
+
+  // A fresh RTC, oscillator stopped and in 24 hour mode, as after the battery is fitted
+  // clockBoot() is all that comes before the first frame
+  mcp7940_model_resetStats();
+  clockBoot();
+  report("clockBoot.cold");
+  clockSetup();
+  report("clockSetup.cold");
+  // Booting again once everything has been set up, which should write nothing
+  clockBoot();
+  report("clockBoot.warm");
+  clockSetup();
+  if(mcp7940_model_stats.transactions != 1) {
+    fprintf(stderr, "a warm boot wrote to the RTC\n");
+    return 1;
+  }
+  report("clockSetup.warm");
+
+  mcp7940_init();
+  report("mcp7940_init");
+  mcp7940_getSeconds();
+  report("mcp7940_getSeconds");
+  mcp7940_getMinutes();
+  report("mcp7940_getMinutes");
+  mcp7940_getHours();
+  report("mcp7940_getHours");
+  mcp7940_time_t time;
+  mcp7940_getTime(&time);
+  report("mcp7940_getTime");
+  mcp7940_setTime(&time);
+  report("mcp7940_setTime");
+  mcp7940_getControlRegister();
+  report("mcp7940_getControlRegister");
+  mcp7940_setControlRegister((1<<MCP7940_SQWEN) | SQWV_1HZ);
+  report("mcp7940_setControlRegister");
+  mcp7940_setSeconds(30, true);
+  report("mcp7940_setSeconds");
+  mcp7940_setMinutes(45);
+  report("mcp7940_setMinutes");
+  mcp7940_setHours(11, use12h);
+  report("mcp7940_setHours");
+  mcp7940_setBatteryBackup(true);
+  report("mcp7940_setBatteryBackup");
+  mcp7940_setTrim(0b00111000);
+  report("mcp7940_setTrim");
+
+  // The same calls in 400 kHz fast mode
+  i2c_setSpeed(I2C_SPEED_FAST);
+  clockBoot();
+  report("fast.clockBoot.warm");
+  clockSetup();
+  report("fast.clockSetup.warm");
+  mcp7940_getTime(&time);
+  report("fast.mcp7940_getTime");
+  mcp7940_setTime(&time);
+  report("fast.mcp7940_setTime");
+  i2c_setSpeed(I2C_SPEED_STANDARD);
+
+  // The hours carry without the bus, and the RTC is only read back once a day
+  seconds = 60;
+  minutes = 59;
+  hours = 10;
+  clockUpdate();
+  report("clockUpdate.hour_wrap");
+  seconds = 60;
+  minutes = 59;
+  hours = 23;
+  clockUpdate();
+  report("clockUpdate.day_wrap");
+
+  // What one burst read saves over reading the seconds, minutes and hours one at a time
+  mcp7940_getSeconds();
+  mcp7940_getMinutes();
+  mcp7940_getHours();
+  unsigned long separateUs = busUs();
+  mcp7940_model_resetStats();
+  mcp7940_getTime(&time);
+  printf("bench,rtc.mcp7940_getTime.saved,%lu,us\n", separateUs - busUs());
+  mcp7940_model_resetStats();
+
+  // 12 hour mode round trips, PM included
+  mcp7940_setHours(13, true);
+  if(mcp7940_getHours() != 13 || mcp7940_model_regs[MCP7940_RTCHOUR] != 0x61) {
+    fprintf(stderr, "12 hour mode did not round trip 13:00\n");
+    return 1;
+  }
+  mcp7940_setHours(0, true);
+  if(mcp7940_getHours() != 0 || mcp7940_model_regs[MCP7940_RTCHOUR] != 0x52) {
+    fprintf(stderr, "12 hour mode did not round trip 00:00\n");
+    return 1;
+  }
+
+  // The calendar carries into a leap day on its own: Wednesday 28 February 2024, 23:59:59
+  time = (mcp7940_time_t){59, 59, 23, 4, 28, 2, 24, false, true};
+  mcp7940_setTime(&time);
+  clockBoot();
+  // The RTC ticks over along with SQW, and is read back since the day wrapped
+  mcp7940_model_tick();
+  seconds = 60;
+  clockUpdate();
+  if(date != 29 || month != 2 || weekday != 4) {
+    fprintf(stderr, "calendar did not carry into 29 February 2024\n");
+    return 1;
+  }
+  // and through the end of the year: Sunday 31 December 2023 is followed by Monday
+  time = (mcp7940_time_t){59, 59, 23, 1, 31, 12, 23, false, true};
+  mcp7940_setTime(&time);
+  clockBoot();
+  if(weekday != 0) {
+    fprintf(stderr, "31 December 2023 was not worked out to be a Sunday\n");
+    return 1;
+  }
+  mcp7940_model_tick();
+  seconds = 60;
+  clockUpdate();
+  if(date != 1 || month != 1 || year != 24 || weekday != 1) {
+    fprintf(stderr, "calendar did not carry into 2024\n");
+    return 1;
+  }
+
+  // Trim learning: the clock is set, then a week later put forward 30s, which is 49.6ppm slow
+  mcp7940_time_t set = {0, 0, 12, 6, 1, 3, 24, false, true};
+  mcp7940_time_t later = {0, 0, 12, 6, 8, 3, 24, false, true};
+  trimCorrection(&set, &set);
+  mcp7940_model_resetStats();
+  time = later;
+  time.seconds = 30;
+  trimCorrection(&later, &time);
+  report("trimCorrection");
+  trimRecord record;
+  if(!trimRead(&record) || record.trim != TRIM_INITIAL + 49 || mcp7940_getTrimSteps() != TRIM_INITIAL + 49 ||
+     record.log[0].delta != 30 || record.log[0].hours != 168) {
+    fprintf(stderr, "trim was not learned from a 30s correction over a week\n");
+    return 1;
+  }
+  // Setting the clock hours out is not mistaken for drift
+  time.minutes = 40;
+  trimCorrection(&later, &time);
+  if(!trimRead(&record) || record.trim != TRIM_INITIAL + 49 || record.pending != 0) {
+    fprintf(stderr, "setting the clock was taken for drift\n");
+    return 1;
+  }
+
+  // Alarm 0 at 07:00 in 12 hour mode, matching on the hour, then night mode swapping SQW for it
+  mcp7940_setHours(22, true);
+  mcp7940_model_resetStats();
+  mcp7940_alarm_t alarm = {0, 0, 7, 0, 0, 0, MCP7940_MATCH_HOURS};
+  mcp7940_setAlarm(0, &alarm);
+  report("mcp7940_setAlarm");
+  if(mcp7940_model_regs[MCP7940_ALM0HOUR] != 0x47 || mcp7940_model_regs[MCP7940_ALM0WKDAY] != 0x20) {
+    fprintf(stderr, "alarm 0 was not set for 07:00 matching the hour\n");
+    return 1;
+  }
+  // The hour read failing, with the read after it going through, leaves the alarm alone
+  mcp7940_model_failIn = 1;
+  alarm.hours = 8;
+  if(mcp7940_setAlarm(0, &alarm) == I2C_OK || mcp7940_model_regs[MCP7940_ALM0HOUR] != 0x47) {
+    fprintf(stderr, "alarm 0 was written after reading the hours failed\n");
+    return 1;
+  }
+  alarm.hours = 7;
+  mcp7940_model_regs[MCP7940_ALM0WKDAY] |= 1<<MCP7940_ALM0IF;
+  if(!mcp7940_alarmFired(0) || mcp7940_clearAlarm(0) || mcp7940_alarmFired(0)) {
+    fprintf(stderr, "alarm 0's flag was not read and cleared\n");
+    return 1;
+  }
+  mcp7940_model_resetStats();
+  clockNightBegin();
+  report("clockNightBegin");
+  if(mcp7940_model_regs[MCP7940_CONTROL] != ((1<<MCP7940_OUT) | (1<<MCP7940_ALM0EN))) {
+    fprintf(stderr, "night did not hand MFP to alarm 0\n");
+    return 1;
+  }
+  clockNightEnd();
+  clockUpdate();
+  report("clockNightEnd");
+
+  // A sanity check that the model keeps time the way the driver reads it
+  mcp7940_setHours(23, false);
+  mcp7940_setMinutes(59);
+  mcp7940_setSeconds(59, true);
+  mcp7940_model_tick();
+  mcp7940_getTime(&time);
+  if(time.hours != 0 || time.minutes != 0 || time.seconds != 0) {
+    fprintf(stderr, "model did not roll over midnight\n");
+    return 1;
+  }
+  printf("bench,rtc.mcp7940.worst_case,%lu,us\n", (unsigned long)MCP7940_WORST_CASE_US);
+  return 0;
+}
@@ -1,4 +1,5 @@
 #include "dim_curve.h"
+#include "hsv_rgb.h"
 #include <stdint.h>
 #include <avr/pgmspace.h>
 
@@ -62,3 +63,89 @@ void getRGB(uint16_t hue, uint8_t val, uint8_t colors[3]) {
   colors[1]=g;
   colors[2]=b;
 }
+
+// Scale a by b/256, rounding up so that scaling by 255 gives back a
+// AVR tiny cores have no MUL instruction, so this is done with 8 shift-and-adds
+//  rather than a call to the 16 bit multiply library routine
+uint8_t scale8(uint8_t a, uint8_t b) {
+  uint16_t result = a;
+  uint16_t shifted = a;
+  for(uint8_t mask = 1; mask != 0; mask <<= 1) {
+    if(b & mask) {
+      result += shifted;
+    }
+    shifted <<= 1;
+  }
+  return result >> 8;
+}
+
+void hsvToRGB(uint16_t hue, uint8_t sat, uint8_t val, uint8_t colors[3]) {
+  /* convert hue, saturation and brightness ( HSB/HSV ) to RGB without any division
+     The hue wheel is six sectors of 256 steps, so the sector is the high byte and the
+     position within it is the low byte.
+     The dim_curve is used on brightness/value and on saturation (inverted), as in getRGB.
+  */
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+
+  if(val == 0) {
+    colors[0] = 0;
+    colors[1] = 0;
+    colors[2] = 0;
+    return;
+  }
+  while(hue >= HUE_MAX) {
+    hue -= HUE_MAX;
+  }
+  val = pgm_read_byte(&dim_curve[val]);
+  sat = 255-pgm_read_byte(&dim_curve[255-sat]);
+
+  // The channel that is off in a fully saturated colour sits at base instead
+  uint8_t base = val - scale8(val, sat);
+  uint8_t frac = hue & 0xFF;
+  uint8_t rise = base + scale8(val - base, frac);
+  uint8_t fall = base + scale8(val - base, 255 - frac);
+
+  switch(hue >> 8) {
+    case 0:
+        r = val;
+        g = rise;
+        b = base;
+    break;
+
+    case 1:
+        r = fall;
+        g = val;
+        b = base;
+    break;
+
+    case 2:
+        r = base;
+        g = val;
+        b = rise;
+    break;
+
+    case 3:
+        r = base;
+        g = fall;
+        b = val;
+    break;
+
+    case 4:
+        r = rise;
+        g = base;
+        b = val;
+    break;
+
+    default:
+        r = val;
+        g = base;
+        b = fall;
+    break;
+  }
+
+  colors[0]=r;
+  colors[1]=g;
+  colors[2]=b;
+}
@@ -1,5 +1,18 @@
 #ifndef __HSV_RGB_H__
 #define __HSV_RGB_H__
 #include <stdint.h>
+
+// Steps in one sixth of the hsvToRGB hue wheel, and in the whole wheel
+#define HUE_SECTOR 256
+#define HUE_MAX (6*HUE_SECTOR)
+// Convert a hue in degrees to hsvToRGB's wheel
+#define HUE_DEGREES(d) ((uint16_t)(((uint32_t)(d)*HUE_MAX + 180)/360))
+
+// hue in degrees, any value (taken modulo 360)
 void getRGB(uint16_t hue, uint8_t val, uint8_t colors[3]);
+// hue 0 to HUE_MAX-1 (larger values are wrapped, slowly), sat and val 0-255
+// Division free, so much cheaper than getRGB on the AVR
+void hsvToRGB(uint16_t hue, uint8_t sat, uint8_t val, uint8_t colors[3]);
+// a*b/256, rounded so that scaling by 255 gives back a
+uint8_t scale8(uint8_t a, uint8_t b);
 #endif //__HSV_RGB_H__
@@ -0,0 +1,79 @@
+#ifndef __LAYOUT_H__
+#define __LAYOUT_H__
+
+// Which face the LEDs make up; the renderer is built from the description of it below
+//  LAYOUT_HHMMSS: six 20 LED digits (glyphs.txt) with an 8 LED colon after the hours, 128 LEDs
+//  LAYOUT_HHMM: four 3x5 digits (glyphs_3x5.txt) with the colon, 68 LEDs
+//  LAYOUT_HHMM_7X5: four 5 wide, 7 tall digits (glyphs_7x5.txt) with the colon, 148 LEDs;
+//   too many for DISPLAY_FRAMEBUFFER's 3 bytes per LED
+#define LAYOUT_HHMMSS 0
+#define LAYOUT_HHMM 1
+#define LAYOUT_HHMM_7X5 2
+#ifndef LAYOUT
+#define LAYOUT LAYOUT_HHMMSS
+#endif
+
+// Slot kinds: a digit lights its glyph, the colon is all on or all off
+#define LAYOUT_DIGIT 0
+#define LAYOUT_COLON 1
+// Slot wiring: the strip runs through the slot in the order of the glyph tables, or the other way
+//  (a digit mounted upside down); row by row and serpentine wiring is baked into the tables by glyphgen
+#define LAYOUT_FORWARD 0
+#define LAYOUT_REVERSED 1
+
+// LAYOUT_SLOTS(X) calls X(name, kind, LEDs, wiring, value) for each slot in the order the strip runs,
+//  each slot starting on the LED after the one before ends
+//  value: what the slot shows, from updateDisplay()'s hours, minutes, seconds and colon
+// LAYOUT_GLYPHS is the generated glyph table the digits use, LAYOUT_DIGIT_LEDS how many LEDs it has
+// LAYOUT_SECONDS says whether there are seconds to show
+#if LAYOUT == LAYOUT_HHMMSS
+#define MAX_LED 128
+#define LAYOUT_GLYPHS "glyphs.h"
+#define LAYOUT_DIGIT_LEDS 20
+#define LAYOUT_SECONDS 1
+#define LAYOUT_SLOTS(X) \
+  X(HH_0, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, hours / 10) \
+  X(HH_1, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, hours % 10) \
+  X(COLON_0, LAYOUT_COLON, 8, LAYOUT_FORWARD, colon) \
+  X(MM_0, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, minutes / 10) \
+  X(MM_1, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, minutes % 10) \
+  X(SS_0, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, seconds / 10) \
+  X(SS_1, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, seconds % 10)
+#elif LAYOUT == LAYOUT_HHMM
+#define MAX_LED 68
+#define LAYOUT_GLYPHS "glyphs_3x5.h"
+#define LAYOUT_DIGIT_LEDS 15
+#define LAYOUT_SECONDS 0
+#define LAYOUT_SLOTS(X) \
+  X(HH_0, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, hours / 10) \
+  X(HH_1, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, hours % 10) \
+  X(COLON_0, LAYOUT_COLON, 8, LAYOUT_FORWARD, colon) \
+  X(MM_0, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, minutes / 10) \
+  X(MM_1, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, minutes % 10)
+#elif LAYOUT == LAYOUT_HHMM_7X5
+#define MAX_LED 148
+#define LAYOUT_GLYPHS "glyphs_7x5.h"
+#define LAYOUT_DIGIT_LEDS 35
+#define LAYOUT_SECONDS 0
+#define LAYOUT_SLOTS(X) \
+  X(HH_0, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, hours / 10) \
+  X(HH_1, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, hours % 10) \
+  X(COLON_0, LAYOUT_COLON, 8, LAYOUT_FORWARD, colon) \
+  X(MM_0, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, minutes / 10) \
+  X(MM_1, LAYOUT_DIGIT, LAYOUT_DIGIT_LEDS, LAYOUT_FORWARD, minutes % 10)
+#else
+#error "LAYOUT is not one of the LAYOUT_ values"
+#endif
+
+#if MAX_LED > 255
+#error "The LED loops count in a byte, so a layout can have at most 255 LEDs"
+#endif
+
+// Index of each slot in the dirty mask: SLOT_HH_0 and so on
+#define LAYOUT_SLOT_INDEX(name, kind, leds, wiring, value) SLOT_##name,
+enum { LAYOUT_SLOTS(LAYOUT_SLOT_INDEX) SLOT_COUNT };
+// The first and last LED of each slot: LED_HH_0 and LED_HH_0_LAST and so on, and LAYOUT_LEDS after them all
+#define LAYOUT_SLOT_LEDS(name, kind, leds, wiring, value) LED_##name, LED_##name##_LAST = LED_##name + (leds) - 1,
+enum { LAYOUT_SLOTS(LAYOUT_SLOT_LEDS) LAYOUT_LEDS };
+
+#endif //__LAYOUT_H__
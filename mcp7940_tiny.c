@@ -3,141 +3,315 @@
 #include "twimaster/i2cmaster.h"
 #include <stdbool.h>
 
+// The MCP7940 stores its values as binary-coded decimals for some dumb reason
+// The ones digit is bits 0-3 and the tens digit is above it, sharing the byte with control bits,
+//  so tensMask says which bits the tens digit has in that register
+static uint8_t fromBCD(uint8_t value, uint8_t tensMask) {
+  return ((value & tensMask)>>4)*10 + (value & 0b1111);
+}
+static uint8_t toBCD(uint8_t value) {
+  uint8_t tens = 0;
+  while(value >= 10) {
+    value -= 10;
+    tens++;
+  }
+  return (tens<<4) | value;
+}
+
+// For hours, there are two options here:
+//  If in 12 hour mode, bit 6 will be 1 and bit 5 will indicate am(0) or pm(1)
+//   and bit 4 will be the tens digit of an hour from 1 to 12
+//  If in 24 hour mode, bit 6 will be 0 and bits 4-5 will be the tens digit of an hour from 0 to 23
+static uint8_t hoursFromRegister(uint8_t hoursVal) {
+  if(hoursVal & (1<<MCP7940_12_24)) {
+    uint8_t hour = fromBCD(hoursVal, 0b10000);
+    if(hour == 12) {
+      hour = 0;
+    }
+    return hour + (hoursVal & (1<<MCP7940_AM_PM) ? 12 : 0);
+  }
+  return fromBCD(hoursVal, 0b110000);
+}
+static uint8_t hoursToRegister(uint8_t newHours, bool set12Hour) {
+  if(!set12Hour) {
+    return toBCD(newHours);
+  }
+  uint8_t pm = 0;
+  if(newHours >= 12) {
+    newHours -= 12;
+    pm = 1<<MCP7940_AM_PM;
+  }
+  if(newHours == 0) {
+    newHours = 12;
+  }
+  return (1<<MCP7940_12_24) | pm | toBCD(newHours);
+}
+
+// The status of the last transfer to the RTC
+static uint8_t lastStatus = I2C_OK;
+
+// Run a transfer to the RTC, trying again a few times if it doesn't answer, as i2c_start_wait() does
+// Each try is bounded by i2c_transfer()'s timeout, so the whole call is bounded by MCP7940_WORST_CASE_US
+static uint8_t transfer(const uint8_t *writeBuf, uint8_t writeLen, uint8_t *readBuf, uint8_t readLen) {
+  i2c_transfer_t t = {MCP7940_ADDR, writeBuf, writeLen, readBuf, readLen, I2C_PENDING, 0};
+  for(uint8_t tries = 0; tries < MCP7940_RETRIES; tries++) {
+    lastStatus = i2c_transfer(&t);
+    if(lastStatus != I2C_ERR_ADDR) {
+      break;
+    }
+  }
+  return lastStatus;
+}
+
+// A failed read gives 0, with the reason in mcp7940_lastStatus()
+static uint8_t readRegister(uint8_t reg) {
+  uint8_t value = 0;
+  if(transfer(&reg, 1, &value, 1)) {
+    return 0;
+  }
+  return value;
+}
+
+static uint8_t writeRegister(uint8_t reg, uint8_t value) {
+  uint8_t buf[2] = {reg, value};
+  return transfer(buf, 2, 0, 0);
+}
+
+uint8_t mcp7940_lastStatus(void) {
+  return lastStatus;
+}
+
 // Initialize, and return if we were able to confirm the RTC exists
 uint8_t mcp7940_init(void) {
-  uint8_t failCode = i2c_start(MCP7940_ADDR + I2C_WRITE);
-  if(failCode) {
-    return failCode;
-  }
   // Grab the current seconds register, which also has the oscillator enabled bit
-  i2c_write(MCP7940_RTCSEC);
-  i2c_rep_start(MCP7940_ADDR + I2C_READ);
-  uint8_t secsVal = i2c_readNak();
-  i2c_stop();
-  secsVal = secsVal | (1<<MCP7940_ST);
-  i2c_start_wait(MCP7940_ADDR + I2C_WRITE);
-  i2c_write(MCP7940_RTCSEC);
-  i2c_write(secsVal);
-  i2c_stop();
-  return false;
+  uint8_t secsVal = readRegister(MCP7940_RTCSEC);
+  if(lastStatus) {
+    return lastStatus;
+  }
+  return writeRegister(MCP7940_RTCSEC, secsVal | (1<<MCP7940_ST));
 }
+
 // Get the current seconds from the RTC
 uint8_t mcp7940_getSeconds(void) {
-  uint8_t secondsVal;
-  i2c_start_wait(MCP7940_ADDR + I2C_WRITE);
-  i2c_write(MCP7940_RTCSEC);
-  i2c_rep_start(MCP7940_ADDR + I2C_READ);
-  secondsVal = i2c_readNak();
-  i2c_stop();
-  // The MCP7940 stores its values as binary-encoded decimals for some dumb reason
-  // For seconds and minutes, bits 0-3 are the ones digit, bits 4-6 are the tens digit
-  return ((0b1110000 & secondsVal)>>4)*10 + (0b1111 & secondsVal);
+  return fromBCD(readRegister(MCP7940_RTCSEC), 0b1110000);
 }
 // Get the current minutes from the RTC
 uint8_t mcp7940_getMinutes(void) {
-  uint8_t minutesVal;
-  i2c_start_wait(MCP7940_ADDR + I2C_WRITE);
-  i2c_write(MCP7940_RTCMIN);
-  i2c_rep_start(MCP7940_ADDR + I2C_READ);
-  minutesVal = i2c_readNak();
-  i2c_stop();
-  // The MCP7940 stores its values as binary-encoded decimals for some dumb reason
-  // For seconds and minutes, bits 0-3 are the ones digit, bits 4-6 are the tens digit
-  return (((0b111<<4) & minutesVal)>>4)*10 + (0b1111 & minutesVal);
-}
-// Get the current hours from the RTC
-// If in 24 hour mode, will return the hour value 0-23
-// If in 12 hour mode, will return the hour value 0-11 in bits 0-3 and bit 4 will be am(0)/pm(1), bit 5 will be 1
+  return fromBCD(readRegister(MCP7940_RTCMIN), 0b1110000);
+}
+// Get the current hours from the RTC, 0-23 whichever mode it is in
 uint8_t mcp7940_getHours(void) {
-  uint8_t hoursVal;
-  i2c_start_wait(MCP7940_ADDR + I2C_WRITE);
-  i2c_write(MCP7940_RTCHOUR);
-  i2c_rep_start(MCP7940_ADDR + I2C_READ);
-  hoursVal = i2c_readNak();
-  i2c_stop();
-  // The MCP7940 stores its values as binary-encoded decimals for some dumb reason
-  // For hours, there are two options here:
-  //  If in 12 hour mode, bit 6 will be 1 and bit 5 will indicate am(0) or pm(1)
-  //   and bit 4 will indicate if the hour tens digit is 0 or 1
-  //  If in 24 hour mode, bit 6 will be 0 and bits 4-5 will be the tens digit
-  // Either way bits 0-3 will be the ones digit
-  if(hoursVal & (1<<MCP7940_12_24)) {
-    // 12 hour mode
-    return (1<<5) | ((1<<MCP7940_AM_PM) & hoursVal ? (1<<4) : 0) | (((0b10000 & hoursVal)>>4)*10 + (0b1111 & hoursVal));
-  } else {
-    // 24 hour mode
-    return ((0b110000 & hoursVal)>>4)*10 + (0b1111 & hoursVal);
+  return hoursFromRegister(readRegister(MCP7940_RTCHOUR));
+}
+bool mcp7940_is12Hour(void) {
+  return readRegister(MCP7940_RTCHOUR) & (1<<MCP7940_12_24);
+}
+
+void mcp7940_decodeTime(const uint8_t regs[7], mcp7940_time_t *time) {
+  time->seconds = fromBCD(regs[0], 0b1110000);
+  time->minutes = fromBCD(regs[1], 0b1110000);
+  time->hours = hoursFromRegister(regs[2]);
+  time->mode12h = regs[2] & (1<<MCP7940_12_24);
+  time->weekday = regs[3] & 0b111;
+  time->batteryBackup = regs[3] & (1<<MCP7940_VBATEN);
+  time->date = fromBCD(regs[4], 0b110000);
+  time->month = fromBCD(regs[5], 0b10000);
+  time->year = fromBCD(regs[6], 0b11110000);
+}
+
+// The register address, then seven reads with the RTC moving its pointer along after each
+static const uint8_t timeRegister = MCP7940_RTCSEC;
+
+uint8_t mcp7940_getTime(mcp7940_time_t *time) {
+  uint8_t regs[7];
+  if(transfer(&timeRegister, 1, regs, 7)) {
+    return lastStatus;
+  }
+  mcp7940_decodeTime(regs, time);
+  return I2C_OK;
+}
+
+// The background read; its buffer has to outlive the call that queues it
+static uint8_t timeReadRegs[7];
+static i2c_transfer_t timeRead = {MCP7940_ADDR, &timeRegister, 1, timeReadRegs, 7, I2C_OK, 0};
+static bool timeReadWanted = false;
+
+bool mcp7940_startTimeRead(void) {
+  if(timeRead.status == I2C_PENDING || i2c_submit(&timeRead)) {
+    return false;
+  }
+  timeReadWanted = true;
+  return true;
+}
+
+bool mcp7940_timeReadDone(mcp7940_time_t *time) {
+  if(!timeReadWanted || timeRead.status == I2C_PENDING) {
+    return false;
+  }
+  timeReadWanted = false;
+  lastStatus = timeRead.status;
+  if(timeRead.status != I2C_OK) {
+    return false;
   }
+  mcp7940_decodeTime(timeReadRegs, time);
+  return true;
+}
+
+// The whole burst takes under a millisecond, and each register is written after the ones below it,
+//  so a carry out of a register we have already written is overwritten by the value we meant anyway
+uint8_t mcp7940_setTime(const mcp7940_time_t *time) {
+  uint8_t buf[8] = {
+    MCP7940_RTCSEC,
+    toBCD(time->seconds) | (1<<MCP7940_ST),
+    toBCD(time->minutes),
+    hoursToRegister(time->hours, time->mode12h),
+    (time->weekday & 0b111) | (time->batteryBackup ? 1<<MCP7940_VBATEN : 0),
+    toBCD(time->date),
+    toBCD(time->month),
+    toBCD(time->year)
+  };
+  return transfer(buf, 8, 0, 0);
 }
 
 // Retrieve various control register settings
 uint8_t mcp7940_getControlRegister(void) {
-  uint8_t controlRegister;
-  i2c_start_wait(MCP7940_ADDR + I2C_WRITE);
-  i2c_write(MCP7940_CONTROL);
-  i2c_rep_start(MCP7940_ADDR + I2C_READ);
-  controlRegister = i2c_readNak();
-  i2c_stop();
-  return controlRegister;
+  return readRegister(MCP7940_CONTROL);
 }
 
 // Enable various control register settings
-void mcp7940_setControlRegister(uint8_t newSetting) {
-  i2c_start_wait(MCP7940_ADDR + I2C_WRITE);
-  i2c_write(MCP7940_CONTROL);
-  i2c_write(newSetting);
-  i2c_stop();
+uint8_t mcp7940_setControlRegister(uint8_t newSetting) {
+  return writeRegister(MCP7940_CONTROL, newSetting);
 }
 
 // Set the seconds to this new value; also can enable or disable the oscillator
-void mcp7940_setSeconds(uint8_t newSeconds, bool enableOscillator) {
-  newSeconds = newSeconds&0b111111;
-  newSeconds = ((newSeconds / 10) << 4) | (newSeconds%10);
-  newSeconds = newSeconds | (enableOscillator? 1<<MCP7940_ST : 0);
-  i2c_start_wait(MCP7940_ADDR + I2C_WRITE);
-  i2c_write(MCP7940_RTCSEC);
-  i2c_write(newSeconds);
-  i2c_stop();
+uint8_t mcp7940_setSeconds(uint8_t newSeconds, bool enableOscillator) {
+  return writeRegister(MCP7940_RTCSEC, toBCD(newSeconds) | (enableOscillator? 1<<MCP7940_ST : 0));
 }
 // Set the minutes to this new value
-void mcp7940_setMinutes(uint8_t newMinutes) {
-  newMinutes = newMinutes&0b111111;
-  newMinutes = ((newMinutes / 10) << 4) | (newMinutes%10);
-  i2c_start_wait(MCP7940_ADDR + I2C_WRITE);
-  i2c_write(MCP7940_RTCMIN);
-  i2c_write(newMinutes);
-  i2c_stop();
+uint8_t mcp7940_setMinutes(uint8_t newMinutes) {
+  return writeRegister(MCP7940_RTCMIN, toBCD(newMinutes));
 }
 // Set the hours to this new value; also can set 12 hour mode (true) or 24 hour mode (false)
-void mcp7940_setHours(uint8_t newHours, bool set12Hour) {
-  newHours = 0b11111&newHours;
-  newHours = (set12Hour? (newHours>12?1<<5:0) :0) | (((newHours/10)&(set12Hour?1:0b11)) <<4) | (newHours%10);
-  i2c_start_wait(MCP7940_ADDR + I2C_WRITE);
-  i2c_write(MCP7940_RTCHOUR);
-  i2c_write(newHours);
-  i2c_stop();
+uint8_t mcp7940_setHours(uint8_t newHours, bool set12Hour) {
+  return writeRegister(MCP7940_RTCHOUR, hoursToRegister(newHours, set12Hour));
 }
 
 // Enable or disable using the battery backup
 // If the battery backup is enabled, when main power is lost, the internal timekeeping will continue working
 //  The device will not be externally operational, however, so i2c and the MFP will be disabled
-void mcp7940_setBatteryBackup(bool enabled) {
-  i2c_start_wait(MCP7940_ADDR + I2C_WRITE);
-  i2c_write(MCP7940_RTCWKDAY);
-  i2c_rep_start(MCP7940_ADDR + I2C_READ);
-  uint8_t curSetting = i2c_readNak();
-  i2c_stop();
+uint8_t mcp7940_setBatteryBackup(bool enabled) {
+  uint8_t curSetting = readRegister(MCP7940_RTCWKDAY);
+  if(lastStatus) {
+    return lastStatus;
+  }
   curSetting = ((~(1<<MCP7940_VBATEN))&curSetting) | (enabled? (1<<MCP7940_VBATEN):0 );
-  i2c_start_wait(MCP7940_ADDR + I2C_WRITE);
-  i2c_write(MCP7940_RTCWKDAY);
-  i2c_write(curSetting);
-  i2c_stop();
+  return writeRegister(MCP7940_RTCWKDAY, curSetting);
 }
 
 // Set the OSCTRIM register to set the value of the trimming
-void mcp7940_setTrim(uint8_t newValue) {
-  i2c_start_wait(MCP7940_ADDR + I2C_WRITE);
-  i2c_write(MCP7940_OSCTRIM);
-  i2c_write(newValue);
-  i2c_stop();
+uint8_t mcp7940_setTrim(uint8_t newValue) {
+  return writeRegister(MCP7940_OSCTRIM, newValue);
+}
+
+uint8_t mcp7940_trimRegister(int16_t steps) {
+  // OSCTRIM is sign and magnitude, SIGN set to add clocks
+  if(steps < 0) {
+    return steps < -MCP7940_TRIM_MAX ? MCP7940_TRIM_MAX : -steps;
+  }
+  return (1<<MCP7940_SIGN) | (steps > MCP7940_TRIM_MAX ? MCP7940_TRIM_MAX : steps);
+}
+
+uint8_t mcp7940_setTrimSteps(int16_t steps) {
+  return mcp7940_setTrim(mcp7940_trimRegister(steps));
+}
+
+int8_t mcp7940_getTrimSteps(void) {
+  uint8_t trim = readRegister(MCP7940_OSCTRIM);
+  int8_t steps = trim & MCP7940_TRIM_MAX;
+  return (trim & (1<<MCP7940_SIGN)) ? steps : -steps;
+}
+
+uint8_t mcp7940_readRegisters(uint8_t reg, void *buf, uint8_t len) {
+  return transfer(&reg, 1, buf, len);
+}
+
+// The register address has to go out in the same write as the data, so it is sent a few bytes at a time
+//  rather than copying all of it to the stack
+#define WRITE_CHUNK 8
+uint8_t mcp7940_writeRegisters(uint8_t reg, const void *buf, uint8_t len) {
+  const uint8_t *data = buf;
+  uint8_t chunk[1 + WRITE_CHUNK];
+  while(len) {
+    uint8_t n = len > WRITE_CHUNK ? WRITE_CHUNK : len;
+    chunk[0] = reg;
+    for(uint8_t i = 0; i < n; i++) {
+      chunk[1 + i] = *data++;
+    }
+    if(transfer(chunk, 1 + n, 0, 0)) {
+      return lastStatus;
+    }
+    reg += n;
+    len -= n;
+  }
+  return I2C_OK;
+}
+
+uint8_t mcp7940_readRam(uint8_t offset, void *buf, uint8_t len) {
+  return mcp7940_readRegisters(MCP7940_RAM_ADDRESS + offset, buf, len);
+}
+
+uint8_t mcp7940_writeRam(uint8_t offset, const void *buf, uint8_t len) {
+  return mcp7940_writeRegisters(MCP7940_RAM_ADDRESS + offset, buf, len);
+}
+
+// The alarm's first register; each alarm is seconds, minutes, hours, weekday, date, month
+#define ALARM_REGISTER(alarm) ((alarm) ? MCP7940_ALM1SEC : MCP7940_ALM0SEC)
+#define ALARM_WKDAY 3
+
+uint8_t mcp7940_setAlarm(uint8_t alarm, const mcp7940_alarm_t *settings) {
+  // The hours have to be in the mode the RTC keeps them in, and ALMPOL lives in alarm 0's weekday
+  // Each read is checked on its own: a later one succeeding would hide an earlier failure
+  uint8_t hourReg = readRegister(MCP7940_RTCHOUR);
+  if(lastStatus) {
+    return lastStatus;
+  }
+  uint8_t polarity = readRegister(MCP7940_ALM0WKDAY) & (1<<MCP7940_ALMPOL);
+  if(lastStatus) {
+    return lastStatus;
+  }
+  uint8_t buf[7] = {
+    ALARM_REGISTER(alarm),
+    toBCD(settings->seconds),
+    toBCD(settings->minutes),
+    hoursToRegister(settings->hours, hourReg & (1<<MCP7940_12_24)),
+    // Writing the flag as 0 clears it
+    polarity | ((settings->match & 0b111)<<MCP7940_ALMMSK) | (settings->weekday & 0b111),
+    toBCD(settings->date),
+    toBCD(settings->month)
+  };
+  return transfer(buf, 7, 0, 0);
+}
+
+bool mcp7940_alarmFired(uint8_t alarm) {
+  // ALM0IF and ALM1IF are the same bit of their weekday registers
+  return readRegister(ALARM_REGISTER(alarm) + ALARM_WKDAY) & (1<<MCP7940_ALM0IF);
+}
+
+uint8_t mcp7940_clearAlarm(uint8_t alarm) {
+  uint8_t reg = ALARM_REGISTER(alarm) + ALARM_WKDAY;
+  uint8_t value = readRegister(reg);
+  if(lastStatus) {
+    return lastStatus;
+  }
+  return writeRegister(reg, value & ~(1<<MCP7940_ALM0IF));
+}
+
+uint8_t mcp7940_setAlarmPolarity(bool activeHigh) {
+  uint8_t value = readRegister(MCP7940_ALM0WKDAY);
+  if(lastStatus) {
+    return lastStatus;
+  }
+  value = (value & ~(1<<MCP7940_ALMPOL)) | (activeHigh ? 1<<MCP7940_ALMPOL : 0);
+  // Write the flag back as it was read, since writing a 0 would lose an alarm that went off
+  return writeRegister(MCP7940_ALM0WKDAY, value);
 }
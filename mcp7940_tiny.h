@@ -55,41 +55,134 @@
 #define MCP7940_ALMPOL                     7 ///< ALM0WKDAY register
 #define MCP7940_ALM0IF                     3 ///< ALM0WKDAY register
 #define MCP7940_ALM1IF                     3 ///< ALM1WKDAY register
+#define MCP7940_ALMMSK                     4 ///< ALM0WKDAY & ALM1WKDAY, 3 bits
+
+// Which fields of an alarm have to agree with the time for it to go off, for mcp7940_alarm_t.match
+#define MCP7940_MATCH_SECONDS              0
+#define MCP7940_MATCH_MINUTES              1
+#define MCP7940_MATCH_HOURS                2
+#define MCP7940_MATCH_WEEKDAY              3
+#define MCP7940_MATCH_DATE                 4
+// Seconds, minutes, hours, weekday, date and month all together
+#define MCP7940_MATCH_ALL                  7
+
+#define MCP7940_RAM_SIZE                  64 ///< Bytes of battery-backed SRAM
+// One OSCTRIM step adds or takes away two 32.768kHz clocks a minute, 1.017ppm, in thousandths of a ppm
+#define MCP7940_TRIM_PPB                1017
+// With CRSTRIM set the trim is applied 128 times a second instead of once a minute, 7812ppm a step
+#define MCP7940_COARSE_TRIM_PPM         7812
+// The largest fine trim either way
+#define MCP7940_TRIM_MAX                 127
 
 #define SQWV_1HZ                           0 //Output a square wave at  1     Hz, affected by digital trimming
 #define SQWV_4KHZ                          1 //Output a square wave at  4.096 kHz, affected by digital trimming
 #define SQWV_8KHZ                          2 //Output a square wave at  8.192 kHz, affected by digital trimming
 #define SQWV_32KHZ                         3 //Output a square wave at 32.768 kHz, NOT affected by digital trimming (passthrough from the crystal)
 
+// The timekeeping registers, RTCSEC through RTCYEAR, decoded
+typedef struct {
+  uint8_t seconds; // 0-59
+  uint8_t minutes; // 0-59
+  uint8_t hours;   // 0-23, whichever mode the RTC keeps time in
+  uint8_t weekday; // 1-7
+  uint8_t date;    // 1-31
+  uint8_t month;   // 1-12
+  uint8_t year;    // 0-99
+  bool mode12h;    // The RTC keeps 12 hour time
+  bool batteryBackup; // VBATEN, which shares RTCWKDAY with the weekday
+} mcp7940_time_t;
+
+// One of the two alarms; only the fields match uses need filling in
+typedef struct {
+  uint8_t seconds; // 0-59
+  uint8_t minutes; // 0-59
+  uint8_t hours;   // 0-23, whichever mode the RTC keeps time in
+  uint8_t weekday; // 1-7
+  uint8_t date;    // 1-31
+  uint8_t month;   // 1-12
+  uint8_t match;   // MCP7940_MATCH_
+} mcp7940_alarm_t;
+
+// Errors: the calls that return a status give I2C_OK (0) or one of the I2C_ERR_ codes in
+//  twimaster/i2cmaster.h; the ones that return a register give 0 on failure and mcp7940_lastStatus() says why
+// How many times a call tries an RTC that doesn't acknowledge its address
+#ifndef MCP7940_RETRIES
+#define MCP7940_RETRIES 3
+#endif
+// The longest any blocking call here can take with the bus stuck, each try timing out and recovering the bus
+#define MCP7940_WORST_CASE_US (MCP7940_RETRIES*(I2C_TIMEOUT_US + I2C_RECOVERY_US))
+// The status of the last transfer to the RTC
+uint8_t mcp7940_lastStatus(void);
+
 // Initialize, and return if we were able to confirm the RTC exists
 uint8_t mcp7940_init(void);
 // Get the current seconds from the RTC
 uint8_t mcp7940_getSeconds(void);
 // Get the current minutes from the RTC
 uint8_t mcp7940_getMinutes(void);
-// Get the current hours from the RTC
-// If in 24 hour mode, will return the hour value 0-23
-// If in 12 hour mode, will return the hour value 0-11 in bits 0-3 and bit 5 will be am(0)/pm(1), bit 5 will be 1
+// Get the current hours from the RTC, 0-23 whether it is in 12 or 24 hour mode
 uint8_t mcp7940_getHours(void);
+// Whether the RTC is keeping 12 hour time
+bool mcp7940_is12Hour(void);
+
+// Read seconds through year in one burst, so no field can tear across a rollover
+uint8_t mcp7940_getTime(mcp7940_time_t *time);
+// Write seconds through year in one burst and start the oscillator
+// hours is encoded for whichever mode mode12h asks for
+uint8_t mcp7940_setTime(const mcp7940_time_t *time);
+// The same burst read, queued to run in the background from the TWI interrupt
+// Returns false if a read is already running or the queue is full; try again later
+bool mcp7940_startTimeRead(void);
+// True, once, when the read has finished and filled in time; false while it is still running or if it failed
+bool mcp7940_timeReadDone(mcp7940_time_t *time);
+// Decode RTCSEC through RTCYEAR, as read with mcp7940_readRegisters()
+void mcp7940_decodeTime(const uint8_t regs[7], mcp7940_time_t *time);
+
+// Read or write len registers in one burst from reg; the RTC moves its address along after each byte,
+//  wrapping within the timekeeping registers and within the SRAM
+uint8_t mcp7940_readRegisters(uint8_t reg, void *buf, uint8_t len);
+uint8_t mcp7940_writeRegisters(uint8_t reg, const void *buf, uint8_t len);
 
 // Retrieve various control register settings
 uint8_t mcp7940_getControlRegister(void);
 // Enable various control register settings
-void mcp7940_setControlRegister(uint8_t newSetting);
+uint8_t mcp7940_setControlRegister(uint8_t newSetting);
 
 // Set the seconds to this new value; also can enable or disable the oscillator
-void mcp7940_setSeconds(uint8_t newSeconds, bool enableOscillator);
+uint8_t mcp7940_setSeconds(uint8_t newSeconds, bool enableOscillator);
 // Set the minutes to this new value
-void mcp7940_setMinutes(uint8_t newMinutes);
-// Set the hours to this new value; also can set 12 hour mode (true) or 24 hour mode (false)
-void mcp7940_setHours(uint8_t newHours, bool set12Hour);
+uint8_t mcp7940_setMinutes(uint8_t newMinutes);
+// Set the hours (0-23) to this new value; also can set 12 hour mode (true) or 24 hour mode (false)
+uint8_t mcp7940_setHours(uint8_t newHours, bool set12Hour);
 
 // Enable or disable using the battery backup
 // If the battery backup is enabled, when main power is lost, the internal timekeeping will continue working
 //  The device will not be externally operational, however, so i2c and the MFP will be disabled
-void mcp7940_setBatteryBackup(bool enabled);
+uint8_t mcp7940_setBatteryBackup(bool enabled);
 
 // Set the OSCTRIM register to set the value of the trimming
-void mcp7940_setTrim(uint8_t newValue);
+uint8_t mcp7940_setTrim(uint8_t newValue);
+// The OSCTRIM value for a trim in signed steps, see mcp7940_setTrimSteps()
+uint8_t mcp7940_trimRegister(int16_t steps);
+// Set the trim in steps of MCP7940_TRIM_PPB, positive to add clocks to a slow crystal, clamped to MCP7940_TRIM_MAX
+uint8_t mcp7940_setTrimSteps(int16_t steps);
+// The trim in the same signed steps
+int8_t mcp7940_getTrimSteps(void);
+
+// Alarms
+// An alarm that goes off sets its flag whatever else is going on, and pulls MFP to its active level
+//  as long as the flag is set, but only with SQWEN off and its ALMxEN set in the control register
+// Set alarm 0 or 1 and clear its flag; it still has to be enabled with ALM0EN or ALM1EN
+uint8_t mcp7940_setAlarm(uint8_t alarm, const mcp7940_alarm_t *settings);
+// Whether the alarm has gone off since its flag was last cleared
+bool mcp7940_alarmFired(uint8_t alarm);
+// Clear the alarm's flag, letting MFP go back to idle
+uint8_t mcp7940_clearAlarm(uint8_t alarm);
+// ALMPOL: MFP is driven high (true) or low (false) while an alarm is going off; shared by both alarms
+uint8_t mcp7940_setAlarmPolarity(bool activeHigh);
+
+// Read or write len bytes of the battery-backed SRAM, starting offset bytes in (0 to MCP7940_RAM_SIZE-1)
+uint8_t mcp7940_readRam(uint8_t offset, void *buf, uint8_t len);
+uint8_t mcp7940_writeRam(uint8_t offset, const void *buf, uint8_t len);
 
 #endif //_MCP7940_TINY
@@ -0,0 +1,41 @@
+#ifndef __RTC_SRAM_H__
+#define __RTC_SRAM_H__
+#include <stdint.h>
+#include "mcp7940_tiny.h"
+
+// Where everything kept across power cuts lives in the MCP7940's battery-backed SRAM
+// Offsets are from MCP7940_RAM_ADDRESS, for mcp7940_readRam() and mcp7940_writeRam()
+// The SRAM comes up holding anything once the battery has been out, so each block has to check itself
+
+// trim.c: the crystal trim and the corrections it was learned from
+#define RTC_SRAM_TRIM 0
+#define RTC_SRAM_TRIM_SIZE 28
+
+// settings.c: what can be changed with the buttons
+#define RTC_SRAM_SETTINGS (RTC_SRAM_TRIM + RTC_SRAM_TRIM_SIZE)
+#define RTC_SRAM_SETTINGS_SIZE 8
+
+// test.c with STACK_STATS: the deepest the stack has been, see stack.h
+#define RTC_SRAM_STACK (RTC_SRAM_SETTINGS + RTC_SRAM_SETTINGS_SIZE)
+#define RTC_SRAM_STACK_SIZE 6
+
+// Unused from here up
+#define RTC_SRAM_FREE (RTC_SRAM_STACK + RTC_SRAM_STACK_SIZE)
+
+#if RTC_SRAM_FREE > MCP7940_RAM_SIZE
+#error "The RTC SRAM blocks don't fit in MCP7940_RAM_SIZE"
+#endif
+
+// The check byte a block keeps after its other len bytes: their sum, starting from seed
+// The seed makes a record of zeros, which is what a fresh SRAM tends to hold, fail the check;
+//  each block has its own, so one block's bytes don't pass for another's
+static inline uint8_t rtcRecordChecksum(const void *record, uint8_t len, uint8_t seed) {
+  const uint8_t *bytes = record;
+  uint8_t sum = seed;
+  for(uint8_t i = 0; i < len; i++) {
+    sum += bytes[i];
+  }
+  return sum;
+}
+
+#endif //__RTC_SRAM_H__
@@ -0,0 +1,78 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "settings.h"
+#include "display.h"
+#include "effects.h"
+#include "clock.h"
+#include "rtc_sram.h"
+#include "mcp7940_tiny.h"
+
+// Change this whenever the record changes shape, so an old one is replaced by the defaults
+#define SETTINGS_VERSION 3
+
+typedef char settingsRecordFits[sizeof(settingsRecord) <= RTC_SRAM_SETTINGS_SIZE ? 1 : -1];
+
+settingsRecord settings;
+// What the SRAM holds, so a save can leave out whatever is the same
+static settingsRecord stored;
+
+static uint8_t checksum(const settingsRecord *record) {
+  return rtcRecordChecksum(record, offsetof(settingsRecord, check), 0xA5);
+}
+
+void loadSettings(void) {
+  if(mcp7940_readRam(RTC_SRAM_SETTINGS, &stored, sizeof(stored)) ||
+     stored.version != SETTINGS_VERSION || stored.check != checksum(&stored)) {
+    settings.version = SETTINGS_VERSION;
+    settings.brightness = BRIGHTNESS;
+    settings.hueStep = HUE_STEP_DEGREES;
+    settings.effect = EFFECT;
+    settings.transition = TRANSITION;
+    settings.flags = USE_12H ? SETTINGS_12H : 0;
+    settings.check = checksum(&settings);
+    // Whatever the SRAM holds isn't a record, so make every byte differ and the first save writes all of it
+    const uint8_t *bytes = (const uint8_t *)&settings;
+    uint8_t *was = (uint8_t *)&stored;
+    for(uint8_t i = 0; i < sizeof(settingsRecord); i++) {
+      was[i] = ~bytes[i];
+    }
+  } else {
+    settings = stored;
+  }
+  applySettings();
+}
+
+void applySettings(void) {
+  setBrightness(settings.brightness);
+  setHueStep(settings.hueStep);
+  // One this build can't draw (from a build with another DISPLAY_MODE or clock) leaves the effect as it is
+  if(!setEffect(settings.effect)) {
+    settings.effect = effect;
+  }
+  if(!setTransition(settings.transition)) {
+    settings.transition = transition;
+  }
+  clockSet12Hour(settings.flags & SETTINGS_12H);
+}
+
+void saveSettings(void) {
+  settings.check = checksum(&settings);
+  const uint8_t *now = (const uint8_t *)&settings;
+  const uint8_t *was = (const uint8_t *)&stored;
+  // One burst from the first byte that changed to the last, which is usually just a field and the check
+  uint8_t first = 0;
+  uint8_t last = sizeof(settingsRecord);
+  while(first < sizeof(settingsRecord) && now[first] == was[first]) {
+    first++;
+  }
+  if(first == sizeof(settingsRecord)) {
+    return;
+  }
+  while(now[last-1] == was[last-1]) {
+    last--;
+  }
+  if(mcp7940_writeRam(RTC_SRAM_SETTINGS + first, now + first, last - first) == I2C_OK) {
+    stored = settings;
+  }
+}
@@ -0,0 +1,37 @@
+#ifndef __SETTINGS_H__
+#define __SETTINGS_H__
+#include <stdint.h>
+#include <stdbool.h>
+
+// What can be changed with the buttons, kept in the RTC's SRAM at RTC_SRAM_SETTINGS so it lasts
+//  as long as the backup battery; a missing or damaged record gives the compiled-in defaults
+
+// settings.flags
+#define SETTINGS_12H 0x01
+
+typedef struct {
+  uint8_t version;
+  // 0-255 before the dim curve, see setBrightness()
+  uint8_t brightness;
+  // Degrees the rainbow moves each second, see setHueStep()
+  uint8_t hueStep;
+  // Which effect colours the face, see setEffect()
+  uint8_t effect;
+  // How a digit changes to the next, see setTransition()
+  uint8_t transition;
+  uint8_t flags;
+  uint8_t check;
+} settingsRecord;
+
+// The settings in use; change them, then applySettings() and saveSettings()
+extern settingsRecord settings;
+
+// Read the record in one burst and apply it, falling back to the defaults if it isn't good
+// Needs the RTC running, so call it after clockBoot()
+void loadSettings(void);
+// Pass the settings on to the display and the clock
+void applySettings(void);
+// Write the settings back, only the bytes that changed since they were last read or written
+void saveSettings(void);
+
+#endif //__SETTINGS_H__
@@ -0,0 +1,283 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "../twimaster/i2cmaster.h"
+#include "../mcp7940_tiny.h"
+#include "mcp7940_model.h"
+
+uint8_t mcp7940_model_regs[MCP7940_MODEL_REGS];
+mcp7940_model_stats_t mcp7940_model_stats;
+uint8_t mcp7940_model_failIn = 0;
+
+// Bits the I2C master can change in each RTCC register; the rest are read-only or read as 0
+static const uint8_t writable[MCP7940_MODEL_RTCC_REGS] = {
+  0xFF, // RTCSEC: ST and seconds
+  0x7F, // RTCMIN
+  0x7F, // RTCHOUR: 12/24, AM/PM or tens, ones
+  0x1F, // RTCWKDAY: OSCRUN is read-only
+  0x3F, // RTCDATE
+  0x1F, // RTCMTH: LPYR is read-only
+  0xFF, // RTCYEAR
+  0xFF, // CONTROL
+  0xFF, // OSCTRIM
+  0x00,
+  0x7F, 0x7F, 0x7F, 0xFF, 0x3F, 0x1F, // ALM0
+  0x00,
+  0x7F, 0x7F, 0x7F, 0xFF, 0x3F, 0x1F, // ALM1
+  0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 // power-fail timestamps
+};
+
+// Where the next byte is read from or written to
+static uint8_t pointer;
+// Set after a START addressed to us, until the STOP
+static bool selected;
+// The next byte written is the register address rather than data
+static bool pointerNext;
+// Between a START and a STOP
+static bool busy;
+
+void mcp7940_model_reset(void) {
+  for(uint8_t reg = 0; reg < MCP7940_MODEL_REGS; reg++) {
+    mcp7940_model_regs[reg] = 0;
+  }
+  // The date and month count from 1
+  mcp7940_model_regs[MCP7940_RTCWKDAY] = 1;
+  mcp7940_model_regs[MCP7940_RTCDATE] = 1;
+  mcp7940_model_regs[MCP7940_RTCMTH] = 1;
+  pointer = 0;
+  selected = false;
+  busy = false;
+}
+
+void mcp7940_model_resetStats(void) {
+  mcp7940_model_stats.transactions = 0;
+  mcp7940_model_stats.starts = 0;
+  mcp7940_model_stats.bytes = 0;
+}
+
+uint32_t mcp7940_model_busBits(void) {
+  return (uint32_t)mcp7940_model_stats.bytes*9 + mcp7940_model_stats.starts + mcp7940_model_stats.transactions;
+}
+
+// Sequential access wraps at the end of the RTCC registers, and at the end of the SRAM
+static void advance(void) {
+  pointer++;
+  if(pointer == MCP7940_MODEL_RTCC_REGS) {
+    pointer = 0;
+  } else if(pointer == MCP7940_MODEL_REGS) {
+    pointer = MCP7940_RAM_ADDRESS;
+  }
+}
+
+static void store(uint8_t reg, uint8_t data) {
+  if(reg >= MCP7940_MODEL_RTCC_REGS) {
+    mcp7940_model_regs[reg] = data;
+    return;
+  }
+  uint8_t mask = writable[reg];
+  mcp7940_model_regs[reg] = (mcp7940_model_regs[reg] & ~mask) | (data & mask);
+  if(reg == MCP7940_RTCSEC) {
+    // The oscillator starts and stops right away as far as OSCRUN is concerned
+    if(data & (1<<MCP7940_ST)) {
+      mcp7940_model_regs[MCP7940_RTCWKDAY] |= 1<<MCP7940_OSCRUN;
+    } else {
+      mcp7940_model_regs[MCP7940_RTCWKDAY] &= ~(1<<MCP7940_OSCRUN);
+    }
+  }
+}
+
+static uint8_t fromBCD(uint8_t value) {
+  return (value>>4)*10 + (value&0xF);
+}
+
+static uint8_t toBCD(uint8_t value) {
+  return ((value/10)<<4) | (value%10);
+}
+
+// Count a BCD field in the low bits of reg from first to last and back round
+// Returns true when it wrapped
+static bool count(uint8_t reg, uint8_t fieldMask, uint8_t first, uint8_t last) {
+  uint8_t value = fromBCD(mcp7940_model_regs[reg] & fieldMask);
+  bool wrapped = value >= last;
+  value = wrapped ? first : value+1;
+  mcp7940_model_regs[reg] = (mcp7940_model_regs[reg] & ~fieldMask) | toBCD(value);
+  return wrapped;
+}
+
+static uint8_t daysInMonth(void) {
+  static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  uint8_t month = fromBCD(mcp7940_model_regs[MCP7940_RTCMTH] & 0x1F);
+  uint8_t year = fromBCD(mcp7940_model_regs[MCP7940_RTCYEAR]);
+  if(month < 1 || month > 12) {
+    return 31;
+  }
+  return days[month-1] + (month == 2 && year%4 == 0 ? 1 : 0);
+}
+
+void mcp7940_model_tick(void) {
+  uint8_t *regs = mcp7940_model_regs;
+  if(!(regs[MCP7940_RTCSEC] & (1<<MCP7940_ST))) {
+    return;
+  }
+  if(!count(MCP7940_RTCSEC, 0x7F, 0, 59)) {
+    return;
+  }
+  if(!count(MCP7940_RTCMIN, 0x7F, 0, 59)) {
+    return;
+  }
+  if(regs[MCP7940_RTCHOUR] & (1<<MCP7940_12_24)) {
+    // 12 hour mode goes 11 -> 12 flipping AM/PM, then 12 -> 1
+    uint8_t hour = fromBCD(regs[MCP7940_RTCHOUR] & 0x1F);
+    bool pm = regs[MCP7940_RTCHOUR] & (1<<MCP7940_AM_PM);
+    bool newDay = false;
+    if(hour == 11) {
+      hour = 12;
+      newDay = pm;
+      pm = !pm;
+    } else {
+      hour = hour >= 12 ? 1 : hour+1;
+    }
+    regs[MCP7940_RTCHOUR] = (1<<MCP7940_12_24) | (pm ? 1<<MCP7940_AM_PM : 0) | toBCD(hour);
+    if(!newDay) {
+      return;
+    }
+  } else if(!count(MCP7940_RTCHOUR, 0x3F, 0, 23)) {
+    return;
+  }
+  count(MCP7940_RTCWKDAY, 0x07, 1, 7);
+  if(!count(MCP7940_RTCDATE, 0x3F, 1, daysInMonth())) {
+    return;
+  }
+  if(count(MCP7940_RTCMTH, 0x1F, 1, 12)) {
+    count(MCP7940_RTCYEAR, 0xFF, 0, 99);
+  }
+  if(fromBCD(regs[MCP7940_RTCYEAR])%4 == 0) {
+    regs[MCP7940_RTCMTH] |= 1<<MCP7940_LPYR;
+  } else {
+    regs[MCP7940_RTCMTH] &= ~(1<<MCP7940_LPYR);
+  }
+}
+
+uint32_t mcp7940_model_scl = MCP7940_MODEL_SCL;
+
+void i2c_init(void) {
+  selected = false;
+  busy = false;
+  mcp7940_model_scl = MCP7940_MODEL_SCL;
+}
+
+unsigned char i2c_setSpeed(unsigned char speed) {
+  mcp7940_model_scl = speed == I2C_SPEED_FAST ? 400000UL : 100000UL;
+  return 0;
+}
+
+// The model never gets stuck, so there is never anything to recover or abandon
+void i2c_recover(void) {
+}
+
+unsigned char i2c_start(unsigned char address) {
+  if(!busy) {
+    mcp7940_model_stats.transactions++;
+    busy = true;
+  }
+  mcp7940_model_stats.starts++;
+  mcp7940_model_stats.bytes++;
+  selected = (address & ~I2C_READ) == MCP7940_ADDR;
+  if(!selected) {
+    return I2C_ERR_ADDR;
+  }
+  pointerNext = !(address & I2C_READ);
+  return 0;
+}
+
+unsigned char i2c_rep_start(unsigned char address) {
+  return i2c_start(address);
+}
+
+void i2c_start_wait(unsigned char address) {
+  i2c_start(address);
+}
+
+void i2c_stop(void) {
+  selected = false;
+  busy = false;
+}
+
+unsigned char i2c_write(unsigned char data) {
+  mcp7940_model_stats.bytes++;
+  if(!selected) {
+    return I2C_ERR_DATA;
+  }
+  if(pointerNext) {
+    pointer = data < MCP7940_MODEL_REGS ? data : 0;
+    pointerNext = false;
+    return 0;
+  }
+  store(pointer, data);
+  advance();
+  return 0;
+}
+
+unsigned char i2c_readAck(void) {
+  mcp7940_model_stats.bytes++;
+  uint8_t data = selected ? mcp7940_model_regs[pointer] : 0xFF;
+  advance();
+  return data;
+}
+
+unsigned char i2c_readNak(void) {
+  return i2c_readAck();
+}
+
+// The queued API runs each transfer to completion on the spot, so there is never anything pending
+unsigned char i2c_submit(i2c_transfer_t *t) {
+  uint8_t status = I2C_OK;
+  uint8_t i;
+  if(mcp7940_model_failIn && --mcp7940_model_failIn == 0) {
+    t->status = I2C_ERR_TIMEOUT;
+    if(t->done) {
+      t->done(t);
+    }
+    return 0;
+  }
+  if(t->writeLen || !t->readLen) {
+    if(i2c_start(t->addr | I2C_WRITE)) {
+      status = I2C_ERR_ADDR;
+    }
+    for(i = 0; status == I2C_OK && i < t->writeLen; i++) {
+      if(i2c_write(t->writeBuf[i])) {
+        status = I2C_ERR_DATA;
+      }
+    }
+  }
+  if(status == I2C_OK && t->readLen) {
+    if(i2c_rep_start(t->addr | I2C_READ)) {
+      status = I2C_ERR_ADDR;
+    }
+    for(i = 0; status == I2C_OK && i < t->readLen; i++) {
+      t->readBuf[i] = i2c_readAck();
+    }
+  }
+  i2c_stop();
+  t->status = status;
+  if(t->done) {
+    t->done(t);
+  }
+  return 0;
+}
+
+unsigned char i2c_transfer(i2c_transfer_t *t) {
+  i2c_submit(t);
+  return t->status;
+}
+
+unsigned char i2c_idle(void) {
+  return 1;
+}
+
+void i2c_abort(void) {
+}
+
+unsigned char i2c_watchdog(void) {
+  return 0;
+}
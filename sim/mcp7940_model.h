@@ -0,0 +1,51 @@
+#ifndef __MCP7940_MODEL_H__
+#define __MCP7940_MODEL_H__
+#include <stdint.h>
+
+// A software MCP7940 that sits behind the i2c_* API of twimaster/i2cmaster.h
+// Queued transfers run to completion inside i2c_submit(), so they are never pending
+// Link sim/mcp7940_model.c instead of twimaster/twimaster.c and the driver talks to it instead of the bus
+// It is plain C, so it builds both for the attiny88 benchmarks and natively (see host/)
+//
+// Modelled: the BCD timekeeping registers with their read-only and unimplemented bits,
+//  ST starting the oscillator (and OSCRUN following it), VBATEN, 12/24 hour mode,
+//  the address pointer wrapping within the RTCC registers and within the SRAM at 0x20
+// Not modelled: alarms firing, power-fail timestamps, the MFP pin
+// A failing bus can be had with mcp7940_model_failIn
+
+// Bus I2C clock the bus time estimates assume after i2c_init(); i2c_setSpeed() changes mcp7940_model_scl
+#ifndef MCP7940_MODEL_SCL
+#define MCP7940_MODEL_SCL 100000UL
+#endif
+extern uint32_t mcp7940_model_scl;
+
+// The timekeeping, alarm and power-fail registers, then the SRAM
+#define MCP7940_MODEL_RTCC_REGS 0x20
+#define MCP7940_MODEL_REGS 0x60
+
+typedef struct {
+  // START to STOP, however many repeated STARTs are in between
+  uint16_t transactions;
+  // Every START and repeated START
+  uint16_t starts;
+  // Every byte on the bus, address bytes included
+  uint16_t bytes;
+} mcp7940_model_stats_t;
+
+// The registers as the device holds them, BCD and all
+extern uint8_t mcp7940_model_regs[MCP7940_MODEL_REGS];
+extern mcp7940_model_stats_t mcp7940_model_stats;
+// Set to n and the nth queued transfer from now fails with I2C_ERR_TIMEOUT without reaching the registers;
+//  0 (the default) fails none
+extern uint8_t mcp7940_model_failIn;
+
+// Power on with every register and the SRAM cleared (oscillator stopped, 24 hour mode)
+void mcp7940_model_reset(void);
+// Zero the transaction counters
+void mcp7940_model_resetStats(void);
+// SCL periods the counted traffic keeps the bus busy for: 9 per byte, one per START and per STOP
+uint32_t mcp7940_model_busBits(void);
+// Let one second pass, if the oscillator is running
+void mcp7940_model_tick(void);
+
+#endif //__MCP7940_MODEL_H__
@@ -0,0 +1,58 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "stack.h"
+
+#if STACK_STATS
+// From the linker: the end of .bss, where nothing but the stack will reach, and the top of SRAM
+extern uint8_t _end;
+extern uint8_t __stack;
+
+volatile uint16_t stackLowest = RAMEND;
+
+// Runs from .init3, with the stack pointer set up but before .data and .bss are filled in and before anything
+//  has been pushed, so everything from the end of .bss to the top of SRAM can be painted
+// In assembler, since the C runtime isn't ready yet
+void stack_paint(void) __attribute__((naked, used, section(".init3")));
+void stack_paint(void) {
+  __asm__ volatile(
+    "ldi r30, lo8(_end)\n\t"
+    "ldi r31, hi8(_end)\n\t"
+    "ldi r24, %0\n\t"
+    "ldi r25, hi8(__stack+1)\n\t"
+    "1: st Z+, r24\n\t"
+    "cpi r30, lo8(__stack+1)\n\t"
+    "cpc r31, r25\n\t"
+    "brlo 1b\n\t"
+    :: "M" (STACK_CANARY) : "r24", "r25", "r30", "r31", "memory");
+}
+
+// The lowest address the stack has written to
+static uint8_t *stackDeepest(void) {
+  uint8_t *p = &_end;
+  while(p <= &__stack && *p == STACK_CANARY) {
+    p++;
+  }
+  return p;
+}
+
+uint16_t stack_maxDepth(void) {
+  return &__stack + 1 - stackDeepest();
+}
+
+uint16_t stack_sampledDepth(void) {
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t lowest = stackLowest;
+  SREG = sreg;
+  return RAMEND - lowest;
+}
+
+uint16_t stack_staticSize(void) {
+  return &_end - (uint8_t *)RAMSTART;
+}
+
+uint16_t stack_headroom(void) {
+  return stackDeepest() - &_end;
+}
+#endif
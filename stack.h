@@ -0,0 +1,47 @@
+#ifndef __STACK_H__
+#define __STACK_H__
+#include <stdint.h>
+#include <avr/io.h>
+
+// 1: Paint the free SRAM with STACK_CANARY before main() and measure how deep the stack gets
+// 0: No measurement
+#ifndef STACK_STATS
+#define STACK_STATS 0
+#endif
+
+#if STACK_STATS
+#define STACK_CANARY 0xC5
+
+// The lowest stack pointer stack_sample() has seen
+extern volatile uint16_t stackLowest;
+
+// Note the stack pointer; call it with interrupts off (it is short enough for interrupt handlers)
+static inline void stack_sample(void) {
+  uint16_t sp = SP;
+  if(sp < stackLowest) {
+    stackLowest = sp;
+  }
+}
+
+// The deepest the stack has been, in bytes from the top of SRAM, going by the first byte up from the end
+//  of .bss that isn't canary any more; it catches every call and interrupt, not just the sampled ones
+uint16_t stack_maxDepth(void);
+// The deepest stack_sample() has seen, in bytes from the top of SRAM
+uint16_t stack_sampledDepth(void);
+// What .data and .bss take
+uint16_t stack_staticSize(void);
+// The SRAM neither the static data nor the stack has ever touched
+uint16_t stack_headroom(void);
+
+// The deepest stack kept in the RTC's SRAM at RTC_SRAM_STACK, so it lasts across resets
+// staticSize says which build it came from: a build with different static data starts over
+typedef struct {
+  uint16_t maxDepth;
+  uint16_t staticSize;
+  uint8_t check;
+} stackRecord;
+#else
+#define stack_sample()
+#endif
+
+#endif //__STACK_H__
@@ -1,289 +1,532 @@
 #include <avr/io.h>
 #include <util/delay.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include "ws2812.h"
-#include "hsv_rgb.h"
+#include "display.h"
 #include <stdbool.h>
 #include <avr/pgmspace.h>
 #include "twimaster/i2cmaster.h"
 #include "mcp7940_tiny.h"
-
-const uint32_t states[10][3] PROGMEM = {
-  {0b11111111, 0b11111001, 0b1111}, //0
-  {0b10011000, 0b01100001, 0b1000}, //1
-  {0b10011111, 0b10011111, 0b1111}, //2
-  {0b10011111, 0b01101111, 0b1111}, //3
-  {0b11111001, 0b01101111, 0b1000}, //4
-  {0b01101111, 0b01101111, 0b1111}, //5
-  {0b01101111, 0b11111111, 0b1111}, //6
-  {0b10011111, 0b01100001, 0b1000}, //7
-  {0b11111111, 0b11111111, 0b1111}, //8
-  {0b11111111, 0b01101111, 0b1000}  //9
-};
-// To be used for each digit to calculate the digit's value
-uint8_t digit_value;
-uint8_t temp0;
+#include "clock.h"
+#include "trim.h"
+#include "settings.h"
+#include "effects.h"
+#include "cycles.h"
+#include "frame.h"
+#include "buttons.h"
+#include "stack.h"
+#include "rtc_sram.h"
 
 #define DOUT PC7
 #define SQW PD2
-#define HH PB6
-#define MM PB7
-#define UPMIN (1<<MM)
-#define UPHOUR (1<<HH)
-#define BUTTONDOWN_RESET 20
-// 1: Use 12 h clock
-// 0: Use 24 h clock
-#define USE_12H 1
-
-volatile uint8_t buttonDown = 0;
-volatile bool checkButton = false;
-volatile bool updateDigits = false;
-volatile bool led = false;
 
+// The internal oscillator runs at 8MHz, so divide it down to whatever F_CPU the build is for
+// Below 4MHz the WS2812 pulses can't be timed (ws2812.h), so that is as far as it goes
+// A build for an external crystal at F_CPU can set CLOCK_PRESCALE to 0
+#ifndef CLOCK_PRESCALE
+#if F_CPU == 8000000UL
+#define CLOCK_PRESCALE 0
+#elif F_CPU == 4000000UL
+#define CLOCK_PRESCALE 1
+#else
+#error "F_CPU is not the 8MHz internal oscillator divided by 1 or 2; set CLOCK_PRESCALE for your clock"
+#endif
+#endif
 
-#define MAX_LED 128
-// The state of the rainbow
-uint16_t state = 0;
-// reserving a byte for loop variant
-uint8_t curLed;
-// reserving 3*(leds) bytes for keeping the data easily accessible
-uint8_t colors[MAX_LED][3];
+// How deep the main loop sleeps between events
+//  SLEEP_DEPTH_IDLE: idle, so Timer0 keeps the frames coming at FRAME_RATE
+//  SLEEP_DEPTH_POWERDOWN: power-down, which stops every clock but the RTC's; Timer0 only runs while awake,
+//   so the face is drawn once per second or button event instead of at FRAME_RATE, and SQW is counted through PCINT18 because INT0's edge detection
+//   needs the I/O clock that power-down stops
+#define SLEEP_DEPTH_IDLE 0
+#define SLEEP_DEPTH_POWERDOWN 1
+#ifndef SLEEP_DEPTH
+#define SLEEP_DEPTH SLEEP_DEPTH_IDLE
+#endif
 
-// The start of the 10s place in hour
-#define HH_0 0
-// The start of the 1s place in hour
-#define HH_1 20
-// The start of the colon
-#define COLON_0 40
-// The start of the 10s place in minute
-#define MM_0 48
-// The start of the 1s place in minute
-#define MM_1 68
-// The start of the 10s place in second
-#define SS_0 88
-// The start of the 1s place in second
-#define SS_1 108
+// Run the RTC bus at 400 kHz (1) or leave it at the 100 kHz i2c_init() sets (0)
+#ifndef RTC_I2C_FAST
+#define RTC_I2C_FAST 1
+#endif
 
+// 1: Measure how much of each second is spent asleep, using Timer1 (see cycles.h),
+//  and show it as a percentage in place of the seconds
+// 0: No measurement
+#ifndef SLEEP_STATS
+#define SLEEP_STATS 0
+#endif
 
-volatile uint8_t seconds = 99;
-volatile uint8_t minutes = 99;
-volatile uint8_t hours = 99;
+// Changes made with the buttons, written to the RTC in one go once the buttons are let go
+bool minutesEdited = false;
+bool hoursEdited = false;
+// What the buttons change: the time, or after each combo of both buttons the next setting, then the time again
+#define PAGE_CLOCK 0
+#define PAGE_BRIGHTNESS 1
+#define PAGE_SPEED 2
+#define PAGE_12H 3
+#define PAGE_EFFECT 4
+#define PAGE_TRANSITION 5
+#define PAGE_COUNT 6
+uint8_t settingsPage = PAGE_CLOCK;
+// The fastest the rainbow can be set to go, in degrees a second
+#define HUE_STEP_MAX 60
+volatile bool led = false;
+#if SLEEP_DEPTH == SLEEP_DEPTH_POWERDOWN
+// Set each second, since there is no frame clock to draw with
+volatile bool secondPassed = false;
+#endif
+#if SLEEP_STATS
+// Cycles spent awake so far this second, and in the whole of the last one
+// Interrupt handlers that run while the loop sleeps count as asleep
+volatile uint32_t awakeCycles = 0;
+volatile uint32_t awakeLastSecond = 0;
+volatile bool awakeUpdated = false;
+// Percent of the last second spent asleep, 99 at most so it fits the seconds digits
+uint8_t asleepPercent = 0;
+// When the main loop last woke up
+uint16_t wokeAt;
+#endif
+#if NIGHT_MODE
+// The face is dark, SQW is off and the chip sleeps in power-down until alarm 0 pulls MFP (INT0) low
+volatile bool night = false;
+volatile bool nightOver = false;
+// Whether it was night by the clock last time round, so night only starts as its hour comes round
+//  and stays over once a button has ended it early
+bool wasNight = false;
+// The press that ended the night early isn't a time change
+bool ignoreButtons = false;
+#endif
 
-ISR(PCINT0_vect) {
-  checkButton=true;
-}
-ISR(INT0_vect) {
+static inline void secondTick(void) {
   seconds++;
   led = !led;
-  updateDigits = true;
+#if SLEEP_DEPTH == SLEEP_DEPTH_POWERDOWN
+  secondPassed = true;
+#endif
+#if SLEEP_STATS
+  awakeLastSecond = awakeCycles;
+  awakeCycles = 0;
+  awakeUpdated = true;
+#endif
 }
 
-void updateDisplay();
-void loop();
-
-int main() {
-  CLKPR = 1<<CLKPCE;   // allow writes to CLKPR
-  CLKPR = 0;   // disable system clock prescaler (run at full 8MHz)
-
-  //setup PCI1 for PCINT6 and 7, for PB6 and 7
-  PCMSK0 |= (1<<PCINT6) | (1<<PCINT7);
-  //Setup PCINT0 to be enabled
-  PCICR |= 1<<PCIE0;
-
-  //Setup HH and MM as inputs, all other pins on port B as outputs
-  DDRB = (uint8_t)( ~(UPMIN | UPHOUR));
-  PORTB |= (UPMIN | UPHOUR);
-
-  // Setup INT0 to trigger on falling edge
-  EICRA = 1<<ISC01;
-  // Setup INT0 to be enabled
-  EIMSK = 1<<INT0;
-
-  // Enable the display
-  ws2812_init();
+#if NIGHT_MODE
+// At night INT0 is a low level interrupt, the only kind that wakes from power-down, and MFP stays low
+//  until the alarm is cleared, so it turns itself off
+static inline void nightWake(void) {
+  EIMSK &= ~(1<<INT0);
+  nightOver = true;
+}
+#endif
 
-  // Enable I2C communication
-  i2c_init();
-  // Enable the RTC
-  uint8_t failCode = 1;
-  while(failCode) {
-    failCode = mcp7940_init();
-    if(failCode) {
-      _delay_ms(100);
-    }
+#if SLEEP_DEPTH == SLEEP_DEPTH_POWERDOWN
+// Interrupts on both edges; only the falling one is a new second, as with INT0
+ISR(PCINT2_vect) {
+  stack_sample();
+  if(!(PIND & (1<<SQW))) {
+    secondTick();
   }
+}
+#if NIGHT_MODE
+ISR(INT0_vect) {
+  stack_sample();
+  nightWake();
+}
+#endif
+#else
+// When the last second came by the 1ms tick; one far from a second after it means SQW was missed or glitched,
+//  and the count is checked against the RTC instead of waiting for the daily re-read
+uint16_t lastSecondAt;
+bool secondSeen = false;
+ISR(INT0_vect) {
+  stack_sample();
+#if NIGHT_MODE
+  if(night) {
+    nightWake();
+    return;
+  }
+#endif
+  uint16_t gap = millis - lastSecondAt;
+  lastSecondAt = millis;
+  // The internal oscillator driving the tick is only good to a few percent
+  if(secondSeen && (gap < 750 || gap > 1250)) {
+    clockResync();
+  }
+  secondSeen = true;
+  secondTick();
+}
+#endif
 
-  mcp7940_setControlRegister( (1<<MCP7940_SQWEN) | SQWV_1HZ );
-
-  mcp7940_setBatteryBackup(true);
-  
-  // Adjust this for your particular crystal, mine's 182ppm fast, so set the register to 91 (bit 7 is 0, for fast time, and then 0-6 is 91)
-  // Second iteration, it was 35 ppm too slow, so now we need to tune it to 147ppm too fast, so set the register to 74 (ceil 73.5)
-  mcp7940_setTrim(0b00111000);
-
-  seconds = mcp7940_getSeconds();
+#if STACK_STATS
+// The deepest stack the RTC has on record for this build, and the second it was last checked against
+uint16_t stackSaved = 0;
+uint8_t stackCheckedAt = 0xFF;
+typedef char stackRecordFits[sizeof(stackRecord) <= RTC_SRAM_STACK_SIZE ? 1 : -1];
 
-  minutes = mcp7940_getMinutes();
+static uint8_t stackChecksum(const stackRecord *record) {
+  return rtcRecordChecksum(record, offsetof(stackRecord, check), 0x3C);
+}
 
-  // bit 5 indicates whether we're in 12 or 24 hour mode
-  hours = mcp7940_getHours();
+// Carry on from the record left before the last reset, if this build left it
+static void loadStackDepth(void) {
+  stackRecord record;
+  if(mcp7940_readRam(RTC_SRAM_STACK, &record, sizeof(record)) == I2C_OK &&
+     record.check == stackChecksum(&record) && record.staticSize == stack_staticSize()) {
+    stackSaved = record.maxDepth;
+  }
+}
 
-#if USE_12H == 0
-  if(hours & (1<<5)) {
-    //we want to be in 24 hour mode
-    mcp7940_setHours( (hours&(1<<4)?12:0) + (hours&0b111), false);
-    hours = mcp7940_getHours();
+// Write the high-water mark to the RTC only when it is deeper than the record
+static void saveStackDepth(void) {
+  uint16_t depth = stack_maxDepth();
+  if(depth <= stackSaved) {
+    return;
   }
-#else
-  if(! (hours & (1<<5))) {
-    //we want to be in 12 hour mode
-    mcp7940_setHours( hours, true);
-    hours = mcp7940_getHours();
+  stackRecord record = {depth, stack_staticSize(), 0};
+  record.check = stackChecksum(&record);
+  if(mcp7940_writeRam(RTC_SRAM_STACK, &record, sizeof(record)) == I2C_OK) {
+    stackSaved = depth;
   }
-#endif // USE_12H
-  hours = hours & 0b11111;
+}
+#endif
 
-  updateDigits=true;
-  while(1) {
-    loop();
+void loop();
+
+// Step the setting being shown, up with the minute button and down with the hour button
+static void changeSetting(bool up) {
+  switch(settingsPage) {
+    case PAGE_BRIGHTNESS:
+      // Never all the way off, or there is nothing to show the setting on
+      if(up && settings.brightness < 255) {
+        settings.brightness++;
+      } else if(!up && settings.brightness > 1) {
+        settings.brightness--;
+      }
+      break;
+    case PAGE_SPEED:
+      if(up && settings.hueStep < HUE_STEP_MAX) {
+        settings.hueStep++;
+      } else if(!up && settings.hueStep > 0) {
+        settings.hueStep--;
+      }
+      break;
+    case PAGE_12H:
+      settings.flags ^= SETTINGS_12H;
+      break;
+    case PAGE_EFFECT:
+      // Skip whatever this build can't draw in time
+      do {
+        settings.effect = (settings.effect + (up ? 1 : EFFECT_COUNT-1)) % EFFECT_COUNT;
+      } while(!setEffect(settings.effect));
+      break;
+    case PAGE_TRANSITION:
+      do {
+        settings.transition = (settings.transition + (up ? 1 : TRANSITION_COUNT-1)) % TRANSITION_COUNT;
+      } while(!setTransition(settings.transition));
+      break;
   }
+  applySettings();
 }
 
-void loop() {
-  if(seconds>59) {
-    seconds = seconds % 60;
-    minutes++;
-    if(minutes == 60) {
-      minutes = mcp7940_getMinutes();
-      hours = mcp7940_getHours();
-      hours = hours & 0b11111;
+// Step the time on each press and auto-repeat, and only write it to the RTC on release
+// On a settings page the same presses change the setting instead, saved on release
+static void handleButtons(void) {
+  uint8_t event;
+  while((event = buttons_poll()) != BUTTON_NONE) {
+#if NIGHT_MODE
+    if(ignoreButtons) {
+      ignoreButtons = BUTTON_KIND(event) != BUTTON_RELEASE;
+      continue;
     }
-  }
-  if(!checkButton && !updateDigits) {
-    _delay_ms(100);
-    return;
-  }
-  if(checkButton) {
-    uint8_t buttonState = (~PINB) & (UPMIN | UPHOUR);
-    if(!buttonState) {
-      checkButton=false;
-      updateDigits = true;
-      buttonDown = 0;
-    } else {
-      if(buttonDown == 0) {
-        buttonDown = BUTTONDOWN_RESET;
-        if(buttonState&UPMIN) {
+#endif
+    switch(BUTTON_KIND(event)) {
+      case BUTTON_COMBO:
+        settingsPage = (settingsPage + 1) % PAGE_COUNT;
+        break;
+      case BUTTON_PRESS:
+      case BUTTON_REPEAT:
+        if(settingsPage != PAGE_CLOCK) {
+          changeSetting(BUTTON_WHICH(event) & BUTTON_MIN);
+          break;
+        }
+        if(BUTTON_WHICH(event) & BUTTON_MIN) {
           minutes = (minutes + 1) % 60;
           seconds = 0;
-          mcp7940_setSeconds(seconds, true);
-          mcp7940_setMinutes(minutes);
+          minutesEdited = true;
         }
-        if(buttonState&UPHOUR) {
+        if(BUTTON_WHICH(event) & BUTTON_HOUR) {
           hours = (hours + 1) % 24;
-          mcp7940_setHours(hours, USE_12H != 0);
+          hoursEdited = true;
         }
-        updateDigits = true;
-      }
-      buttonDown--;
-      _delay_ms(10);
+        break;
+      case BUTTON_RELEASE:
+        if(settingsPage != PAGE_CLOCK) {
+          // Only what changed since the last save goes to the RTC, however many steps it took
+          saveSettings();
+        }
+        if(minutesEdited || hoursEdited) {
+          // Read the rest of the date so the burst write puts it back as it was
+          mcp7940_time_t now;
+          bool read = mcp7940_getTime(&now) == I2C_OK;
+          mcp7940_time_t before = now;
+          if(minutesEdited) {
+            now.seconds = seconds % 60;
+            now.minutes = minutes;
+          }
+          if(hoursEdited) {
+            now.hours = hours;
+          }
+          now.mode12h = use12h;
+          if(!read) {
+            // The rest of the date is unknown, so a burst write would put garbage in the calendar and VBATEN;
+            //  write only the fields that were edited
+            if(minutesEdited) {
+              mcp7940_setSeconds(seconds % 60, true);
+              mcp7940_setMinutes(minutes);
+            }
+            if(hoursEdited) {
+              mcp7940_setHours(hours, use12h);
+            }
+          } else {
+            mcp7940_setTime(&now);
+            // Putting the minutes right says how far the RTC drifted since it was last set
+            if(minutesEdited) {
+              trimCorrection(&before, &now);
+            }
+          }
+        }
+        minutesEdited = false;
+        hoursEdited = false;
+        break;
     }
   }
-  if(updateDigits) {
-    updateDisplay();
-    updateDigits=false;
+}
+
+// Show the time, or on a settings page the page number in the hours and the setting in the minutes and seconds
+static void drawFace(uint8_t shownSeconds) {
+  if(settingsPage == PAGE_CLOCK) {
+    updateDisplay(clockShownHours(), minutes, shownSeconds, led);
+    return;
   }
+  uint8_t value = use12h ? 12 : 24;
+  if(settingsPage == PAGE_BRIGHTNESS) {
+    value = settings.brightness;
+  } else if(settingsPage == PAGE_SPEED) {
+    value = settings.hueStep;
+  } else if(settingsPage == PAGE_EFFECT) {
+    value = settings.effect;
+  } else if(settingsPage == PAGE_TRANSITION) {
+    value = settings.transition;
+  }
+#if LAYOUT_SECONDS
+  updateDisplay(settingsPage, value / 100, value % 100, false);
+#else
+  // No seconds to put the rest in, so the page shares the hours with the hundreds
+  updateDisplay(settingsPage*10 + value / 100, value % 100, 0, false);
+#endif
 }
 
-void updateDisplay() {
-  state+=5;
-  // hours 10s digit
-  digit_value = hours / 10;
-  for(curLed = HH_0; curLed < HH_1; curLed++) {
-    temp0 = curLed-HH_0;
-    if( !(pgm_read_byte(&states[digit_value][temp0/8]) & (1<<(temp0%8))) ) {
-      colors[curLed][0] = 0;
-      colors[curLed][1] = 0;
-      colors[curLed][2] = 0;
-      continue;
-    }
-    getRGB(state+(3*curLed), 50, colors[curLed]);
+#if NIGHT_MODE
+// Turn the face off and hand MFP to the alarm for the end of the night
+static void startNight(void) {
+  if(clockNightBegin()) {
+    // The RTC didn't take it, so SQW may still be running; stay as we are
+    return;
   }
-  // hours 1s digit
-  digit_value = hours % 10;
-  for(curLed = HH_1; curLed < COLON_0; curLed++) {
-    temp0 = curLed-HH_1;
-    if( !(pgm_read_byte(&states[digit_value][temp0/8]) & (1<<(temp0%8))) ) {
-      colors[curLed][0] = 0;
-      colors[curLed][1] = 0;
-      colors[curLed][2] = 0;
-      continue;
-    }
-    getRGB(state+(3*curLed), 50, colors[curLed]);
+  setBrightness(0);
+  drawFace(seconds);
+  cli();
+  night = true;
+  nightOver = false;
+#if SLEEP_DEPTH == SLEEP_DEPTH_POWERDOWN
+  PCMSK2 &= ~(1<<PCINT18);
+#endif
+  EICRA = 0;
+  EIFR = 1<<INTF0;
+  EIMSK = 1<<INT0;
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sei();
+}
+
+// The alarm went off or a button was pressed: put SQW back and the face on
+static void endNight(void) {
+  ignoreButtons = !nightOver;
+  cli();
+  night = false;
+#if SLEEP_DEPTH == SLEEP_DEPTH_POWERDOWN
+  EIMSK = 0;
+  PCMSK2 |= 1<<PCINT18;
+#else
+  EICRA = 1<<ISC01;
+  EIFR = 1<<INTF0;
+  EIMSK = 1<<INT0;
+  secondSeen = false;
+  set_sleep_mode(SLEEP_MODE_IDLE);
+#endif
+  sei();
+  clockNightEnd();
+  setBrightness(settings.brightness);
+}
+#endif
+
+// Sleep until an interrupt has something for the loop to do
+// Interrupts stay off from the last check until the sleep instruction (sei only takes effect after
+//  the instruction that follows it), so an event that lands in between still wakes us straight away
+static void sleepUntilEvent(void) {
+  cli();
+#if NIGHT_MODE
+  // Only the alarm or a button wakes us at night
+  if(night && (nightOver || buttons_busy())) {
+    sei();
+    return;
   }
-  // colon
-  if(!led) {
-    for(curLed = COLON_0; curLed < MM_0; curLed++) {
-      colors[curLed][0] = 0;
-      colors[curLed][1] = 0;
-      colors[curLed][2] = 0;
-    }
-  } else {
-    for(curLed = COLON_0; curLed < MM_0; curLed++) {
-      getRGB(state+(3*curLed), 50, colors[curLed]);
-    }
+  if(!night)
+#endif
+#if SLEEP_DEPTH == SLEEP_DEPTH_POWERDOWN
+  // Power-down stops the TWI clock too, so stay up until the RTC traffic is done
+  if(buttons_busy() || secondPassed || !i2c_idle()) {
+#else
+  // A held or bouncing button is taken care of by the 1ms tick waking us
+  if(frame_pending()) {
+#endif
+    sei();
+    return;
   }
-  // minutes 10s digit
-  digit_value = minutes / 10;
-  for(curLed = MM_0; curLed < MM_1; curLed++) {
-    temp0 = curLed-MM_0;
-    if( !(pgm_read_byte(&states[digit_value][temp0/8]) & (1<<(temp0%8))) ) {
-      colors[curLed][0] = 0;
-      colors[curLed][1] = 0;
-      colors[curLed][2] = 0;
-      continue;
-    }
-    getRGB(state+(3*curLed), 50, colors[curLed]);
+#if SLEEP_STATS
+  // Timer1 wraps every 65ms of awake time, far longer than the loop ever runs between sleeps
+  awakeCycles += (uint16_t)(cycles_now() - wokeAt) * (uint32_t)CYCLES_PER_COUNT;
+#endif
+  sleep_enable();
+  sei();
+  sleep_cpu();
+  sleep_disable();
+#if SLEEP_STATS
+  wokeAt = cycles_now();
+#endif
+}
+
+int main() {
+  CLKPR = 1<<CLKPCE;   // allow writes to CLKPR
+  CLKPR = CLOCK_PRESCALE;   // divide the clock down to F_CPU (0 is no division, full 8MHz)
+
+  //Setup the buttons as inputs, all other pins on port B as outputs
+  DDRB = (uint8_t)( ~BUTTON_ALL);
+  buttons_init();
+
+#if SLEEP_DEPTH == SLEEP_DEPTH_POWERDOWN
+  // Setup PCINT18 for SQW on PD2, which can wake the chip from power-down
+  PCMSK2 |= 1<<PCINT18;
+  PCICR |= 1<<PCIE2;
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+#else
+  // Setup INT0 to trigger on falling edge
+  EICRA = 1<<ISC01;
+  // Setup INT0 to be enabled
+  EIMSK = 1<<INT0;
+  set_sleep_mode(SLEEP_MODE_IDLE);
+#endif
+
+  // Enable the display
+  ws2812_init();
+#if RENDER_STATS || SLEEP_STATS
+  cycles_init();
+#endif
+
+  // Enable I2C communication
+  i2c_init();
+#if RTC_I2C_FAST
+  i2c_setSpeed(I2C_SPEED_FAST);
+#endif
+  // Read the time and the settings, retrying until the RTC answers, and put them on the face straight away
+  // Setting the RTC up is left until after, and in a warm boot writes nothing
+  while(clockBoot()) {
+    _delay_ms(10);
   }
-  // minutes 1s digit
-  digit_value = minutes % 10;
-  for(curLed = MM_1; curLed < SS_0; curLed++) {
-    temp0 = curLed-MM_1;
-    if( !(pgm_read_byte(&states[digit_value][temp0/8]) & (1<<(temp0%8))) ) {
-      colors[curLed][0] = 0;
-      colors[curLed][1] = 0;
-      colors[curLed][2] = 0;
-      continue;
-    }
-    getRGB(state+(3*curLed), 50, colors[curLed]);
+  loadSettings();
+  drawFace(seconds);
+  clockSetup();
+#if STACK_STATS
+  loadStackDepth();
+#endif
+
+  // Start drawing frames and the tick the buttons use; interrupts were only ever turned on by the bit-banged flush before
+  frame_init();
+#if SLEEP_STATS
+  wokeAt = cycles_now();
+#endif
+  sei();
+  while(1) {
+    loop();
   }
-  // seconds 10s digit
-  digit_value = seconds / 10;
-  for(curLed = SS_0; curLed < SS_1; curLed++) {
-    temp0 = curLed-SS_0;
-    if( !(pgm_read_byte(&states[digit_value][temp0/8]) & (1<<(temp0%8))) ) {
-      colors[curLed][0] = 0;
-      colors[curLed][1] = 0;
-      colors[curLed][2] = 0;
-      continue;
+}
+
+void loop() {
+#if NIGHT_MODE
+  if(night) {
+    if(!nightOver && !buttons_busy()) {
+      sleepUntilEvent();
+      return;
     }
-    getRGB(state+(3*curLed), 50, colors[curLed]);
+    endNight();
   }
-  // seconds 1s digit
-  digit_value = seconds % 10;
-  for(curLed = SS_1; curLed < MAX_LED; curLed++) {
-    temp0 = curLed-SS_1;
-    if( !(pgm_read_byte(&states[digit_value][temp0/8]) & (1<<(temp0%8))) ) {
-      colors[curLed][0] = 0;
-      colors[curLed][1] = 0;
-      colors[curLed][2] = 0;
-      continue;
-    }
-    getRGB(state+(3*curLed), 50, colors[curLed]);
+#endif
+  clockUpdate();
+#if NIGHT_MODE
+  bool isNight = clockIsNight();
+  if(isNight && !wasNight) {
+    wasNight = true;
+    startNight();
+    return;
   }
+  wasNight = isNight;
+#endif
+  handleButtons();
+#if STACK_STATS
   cli();
-  for(curLed = 0; curLed < MAX_LED; curLed++) {
-    ws2812_set_single(colors[curLed][0],colors[curLed][1],colors[curLed][2]);
-  }
+  stack_sample();
   sei();
+  if(stackCheckedAt != seconds) {
+    stackCheckedAt = seconds;
+    saveStackDepth();
+  }
+#endif
+#if SLEEP_STATS
+  // Shown where the seconds normally are; worked out once a second to keep the division out of the measurement
+  if(awakeUpdated) {
+    cli();
+    uint32_t awake = awakeLastSecond;
+    awakeUpdated = false;
+    sei();
+    uint8_t awakePercent = awake >= F_CPU ? 100 : awake / (F_CPU/100);
+    asleepPercent = awakePercent ? 100 - awakePercent : 99;
+  }
+  uint8_t shownSeconds = asleepPercent;
+#else
+  uint8_t shownSeconds = seconds;
+#endif
+#if SLEEP_DEPTH == SLEEP_DEPTH_POWERDOWN
+  // No frame clock while powered down, so draw whenever something woke us and move the rainbow once a second
+  if(secondPassed) {
+    secondPassed = false;
+    stepAnimation();
+    // A background read still going after a whole second is stuck
+    i2c_watchdog();
+  }
+  drawFace(shownSeconds);
+#else
+  // Draw at FRAME_RATE; if frames were missed, draw once and catch the animation up
+  uint8_t frames = frame_due();
+  if(frames) {
+    frame_begin();
+    // A background read that made no progress for a whole frame is stuck, so drop it rather than wait on it
+    i2c_watchdog();
+    tickAnimation(frames);
+    drawFace(shownSeconds);
+    frame_end();
+  }
+#endif
+  sleepUntilEvent();
 }
@@ -0,0 +1,128 @@
+/*
+ * Host-side glyph compiler: reads glyphs.txt on stdin and writes glyphs.h on stdout
+ *  tools/glyphgen [name [width]]: name is the file being read, for the messages and the header comment
+ *   With a width the LEDs are given in reading order, rows of width LEDs top to bottom, for a digit wired
+ *   serpentine: the first row left to right, the next right to left and so on; the tables are in wiring order
+ *
+ * glyphs.h holds two PROGMEM tables for each digit:
+ *  glyph_bits: the lit LEDs packed 8 to a byte, LED n is bit (n%8) of byte (n/8)
+ *  glyph_lit: the offsets of only the lit LEDs, so the renderer can walk them directly,
+ *   with glyph_lit_start giving where each digit's run of offsets starts (and ends)
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define MAX_GLYPHS 10
+#define MAX_LEDS 64
+
+static int lit[MAX_GLYPHS][MAX_LEDS];
+static int ledCount = -1;
+
+int main(int argc, char **argv) {
+  const char *name = argc > 1 ? argv[1] : "glyphs.txt";
+  int width = argc > 2 ? atoi(argv[2]) : 0;
+  char line[256];
+  int lineNo = 0;
+  int seen = 0;
+
+  while(fgets(line, sizeof(line), stdin)) {
+    lineNo++;
+    char *c = line;
+    while(*c == ' ' || *c == '\t') c++;
+    if(*c == '\n' || *c == '\r' || *c == '\0' || (c[0] == '/' && c[1] == '/')) {
+      continue;
+    }
+    if(*c < '0' || *c > '9') {
+      fprintf(stderr, "%s:%d: expected a digit\n", name, lineNo);
+      return 1;
+    }
+    int glyph = *c++ - '0';
+    if(seen & (1<<glyph)) {
+      fprintf(stderr, "%s:%d: digit %d defined twice\n", name, lineNo, glyph);
+      return 1;
+    }
+    seen |= 1<<glyph;
+
+    int leds = 0;
+    for(; *c && *c != '\n' && *c != '\r'; c++) {
+      if(*c == ' ' || *c == '\t') continue;
+      if(*c != '#' && *c != '.') {
+        fprintf(stderr, "%s:%d: unexpected '%c', use '#' or '.'\n", name, lineNo, *c);
+        return 1;
+      }
+      if(leds == MAX_LEDS) {
+        fprintf(stderr, "%s:%d: more than %d LEDs\n", name, lineNo, MAX_LEDS);
+        return 1;
+      }
+      int row = width ? leds / width : 0;
+      int wired = row % 2 ? row*width + width-1 - leds%width : leds;
+      if(wired >= MAX_LEDS) {
+        fprintf(stderr, "%s:%d: more than %d LEDs\n", name, lineNo, MAX_LEDS);
+        return 1;
+      }
+      lit[glyph][wired] = (*c == '#');
+      leds++;
+    }
+    if(ledCount < 0) {
+      ledCount = leds;
+    } else if(leds != ledCount) {
+      fprintf(stderr, "%s:%d: %d LEDs, but earlier digits have %d\n", name, lineNo, leds, ledCount);
+      return 1;
+    }
+  }
+  if(seen != (1<<MAX_GLYPHS)-1) {
+    fprintf(stderr, "%s: all of the digits 0-9 must be defined\n", name);
+    return 1;
+  }
+  if(width && ledCount % width) {
+    fprintf(stderr, "%s: %d LEDs is not whole rows of %d\n", name, ledCount, width);
+    return 1;
+  }
+
+  int bytes = (ledCount+7)/8;
+  printf("// Generated by tools/glyphgen from %s, do not edit\n", name);
+  printf("#ifndef __GLYPHS_H__\n#define __GLYPHS_H__\n");
+  printf("#include <stdint.h>\n#include <avr/pgmspace.h>\n\n");
+  printf("// LEDs in one digit\n#define GLYPH_LEDS %d\n", ledCount);
+  printf("// Bytes of packed bits per digit\n#define GLYPH_BYTES %d\n\n", bytes);
+
+  printf("const uint8_t glyph_bits[%d][GLYPH_BYTES] PROGMEM = {\n", MAX_GLYPHS);
+  for(int g = 0; g < MAX_GLYPHS; g++) {
+    printf("  {");
+    for(int b = 0; b < bytes; b++) {
+      int value = 0;
+      for(int bit = 0; bit < 8 && b*8+bit < ledCount; bit++) {
+        value |= lit[g][b*8+bit] << bit;
+      }
+      printf("%s0x%02X", b ? ", " : "", value);
+    }
+    printf("}%s //%d\n", g < MAX_GLYPHS-1 ? "," : " ", g);
+  }
+  printf("};\n\n");
+
+  int total = 0;
+  printf("const uint8_t glyph_lit_start[%d] PROGMEM = {", MAX_GLYPHS+1);
+  for(int g = 0; g < MAX_GLYPHS; g++) {
+    printf("%d, ", total);
+    for(int led = 0; led < ledCount; led++) {
+      total += lit[g][led];
+    }
+  }
+  printf("%d};\n\n", total);
+  if(total > 255) {
+    fprintf(stderr, "%s: %d lit LEDs in all, more than the byte offsets in glyph_lit_start can reach\n", name, total);
+    return 1;
+  }
+
+  printf("const uint8_t glyph_lit[%d] PROGMEM = {\n", total);
+  for(int g = 0; g < MAX_GLYPHS; g++) {
+    printf("  ");
+    for(int led = 0; led < ledCount; led++) {
+      if(lit[g][led]) printf("%d, ", led);
+    }
+    printf("//%d\n", g);
+  }
+  printf("};\n\n#endif //__GLYPHS_H__\n");
+  return 0;
+}
@@ -0,0 +1,95 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "trim.h"
+#include "clock.h"
+#include "rtc_sram.h"
+#include "mcp7940_tiny.h"
+
+#define TRIM_RECORD_VERSION 1
+
+// Only the fine trim is used: a CRSTRIM step is MCP7940_COARSE_TRIM_PPM, far more than a crystal is ever off,
+//  so clockSetup() leaves CRSTRIM clear and the trim stops at MCP7940_TRIM_MAX steps (129ppm) either way
+
+typedef char trimRecordFits[sizeof(trimRecord) <= RTC_SRAM_TRIM_SIZE ? 1 : -1];
+
+static uint8_t checksum(const trimRecord *record) {
+  return rtcRecordChecksum(record, offsetof(trimRecord, check), 0x5A);
+}
+
+bool trimRead(trimRecord *record) {
+  if(mcp7940_readRam(RTC_SRAM_TRIM, record, sizeof(trimRecord))) {
+    return false;
+  }
+  return record->version == TRIM_RECORD_VERSION && record->check == checksum(record);
+}
+
+static void trimWrite(trimRecord *record) {
+  record->version = TRIM_RECORD_VERSION;
+  record->check = checksum(record);
+  mcp7940_writeRam(RTC_SRAM_TRIM, record, sizeof(trimRecord));
+}
+
+int8_t trimLoad(void) {
+  trimRecord record;
+  if(!trimRead(&record)) {
+    uint8_t *bytes = (uint8_t *)&record;
+    for(uint8_t i = 0; i < sizeof(trimRecord); i++) {
+      bytes[i] = 0;
+    }
+    record.trim = TRIM_INITIAL;
+    trimWrite(&record);
+  }
+  return record.trim;
+}
+
+void trimCorrection(const mcp7940_time_t *before, const mcp7940_time_t *after) {
+  trimRecord record;
+  if(!trimRead(&record)) {
+    return;
+  }
+  // Within the hour, so the shortest way round: 59:50 to 00:05 is 15 seconds forward
+  int16_t delta = (after->minutes - before->minutes)*60 + (after->seconds - before->seconds);
+  if(delta > 1800) {
+    delta -= 3600;
+  } else if(delta < -1800) {
+    delta += 3600;
+  }
+
+  uint32_t beforeAt = clockTimestamp(before);
+  bool restart = true;
+  if(record.setAt && beforeAt > record.setAt) {
+    uint32_t elapsed = beforeAt - record.setAt;
+    record.log[record.next].delta = delta;
+    record.log[record.next].hours = elapsed/3600 > 0xFFFF ? 0xFFFF : elapsed/3600;
+    record.next = (record.next + 1) % TRIM_LOG_LEN;
+
+    int16_t pending = record.pending + delta;
+    uint16_t size = pending < 0 ? -pending : pending;
+    if(size > 2 + elapsed/(1000000/TRIM_MAX_PPM)) {
+      // Too much to be drift: the clock was set rather than corrected, so measure from here
+    } else if(elapsed >= TRIM_MIN_HOURS*3600UL) {
+      // How many ms one step of trim makes up over the time since setAt; the clock was put forward by
+      //  pending seconds because it ran slow, so that many more steps of clocks get added
+      uint32_t msPerStep = elapsed/1000*MCP7940_TRIM_PPB/1000;
+      int32_t steps = ((int32_t)size*1000 + msPerStep/2) / msPerStep;
+      int16_t trim = record.trim + (pending < 0 ? -steps : steps);
+      if(trim > MCP7940_TRIM_MAX) {
+        trim = MCP7940_TRIM_MAX;
+      } else if(trim < -MCP7940_TRIM_MAX) {
+        trim = -MCP7940_TRIM_MAX;
+      }
+      record.trim = trim;
+      mcp7940_setTrimSteps(trim);
+    } else {
+      // Not long enough to tell yet, so keep adding up against the same setAt
+      record.pending = pending;
+      restart = false;
+    }
+  }
+  if(restart) {
+    record.setAt = clockTimestamp(after);
+    record.pending = 0;
+  }
+  trimWrite(&record);
+}
@@ -0,0 +1,58 @@
+#ifndef __TRIM_H__
+#define __TRIM_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include "mcp7940_tiny.h"
+
+// Learns how far off the RTC's crystal is from the corrections made with the buttons, and trims it to match
+// Corrections are added up against the last time the clock was set, and once enough time has passed
+//  the total gives the error in ppm, which is taken off OSCTRIM
+
+// OSCTRIM in signed steps (see mcp7940_setTrimSteps()) for a clock that hasn't learned anything yet
+// This was hand-tuned for the first clock; 0 suits an unknown crystal
+#ifndef TRIM_INITIAL
+#define TRIM_INITIAL -56
+#endif
+// How long corrections are added up before the trim is changed
+// A correction made by eye is good to about a second, which is under 2ppm over a week
+#ifndef TRIM_MIN_HOURS
+#define TRIM_MIN_HOURS 168
+#endif
+// An error bigger than this is the clock being set, e.g. after the battery was changed, rather than drift
+#ifndef TRIM_MAX_PPM
+#define TRIM_MAX_PPM 300
+#endif
+// How many corrections the log keeps
+#define TRIM_LOG_LEN 4
+
+typedef struct {
+  // Seconds the clock was put forward by, negative if it was put back
+  int16_t delta;
+  // Hours since the time the corrections are measured from
+  uint16_t hours;
+} trimLogEntry;
+
+// Kept in the RTC's SRAM at RTC_SRAM_TRIM
+typedef struct {
+  // When the corrections are measured from, by clockTimestamp(); 0 if the clock has never been set
+  uint32_t setAt;
+  // Seconds of correction since setAt
+  int16_t pending;
+  // The trim in signed steps
+  int8_t trim;
+  // The log slot the next correction goes in
+  uint8_t next;
+  trimLogEntry log[TRIM_LOG_LEN];
+  uint8_t version;
+  uint8_t check;
+} trimRecord;
+
+// The trim in signed steps that OSCTRIM should hold, starting a new record if there isn't one
+int8_t trimLoad(void);
+// The time was changed from before to after with the buttons; only the minutes and seconds count,
+//  the hours being left to daylight saving and time zones
+void trimCorrection(const mcp7940_time_t *before, const mcp7940_time_t *after);
+// Read the record, e.g. to see the log; returns false if there isn't a good one
+bool trimRead(trimRecord *record);
+
+#endif //__TRIM_H__
@@ -86,7 +86,10 @@
 #error "This library requires AVR-GCC 3.4 or later, update to newer AVR-GCC compiler !"
 #endif
 
+/* the host build links sim/mcp7940_model.c against this API, so it can't pull in AVR headers */
+#ifdef __AVR__
 #include <avr/io.h>
+#endif
 
 /** defines the data direction (reading from I2C device) in i2c_start(),i2c_rep_start() */
 #define I2C_READ    1
@@ -95,6 +98,23 @@
 #define I2C_WRITE   0
 
 
+/** i2c_setSpeed() argument: 100 kHz standard mode, what i2c_init() sets */
+#define I2C_SPEED_STANDARD 0
+/** i2c_setSpeed() argument: 400 kHz fast mode */
+#define I2C_SPEED_FAST     1
+
+/** the longest any one wait on the TWI may take before the bus is recovered */
+#ifndef I2C_TIMEOUT_US
+#define I2C_TIMEOUT_US 2000
+#endif
+/** how long i2c_recover() takes at most: 9 clocks and a STOP of 10 us each */
+#define I2C_RECOVERY_US 100
+/** how many times i2c_start_wait() tries before giving up on a device that doesn't answer */
+#ifndef I2C_START_RETRIES
+#define I2C_START_RETRIES 3
+#endif
+
+
 /**
  @brief initialize the I2C master interace. Need to be called only once 
  @return none
@@ -102,8 +122,28 @@
 extern void i2c_init(void);
 
 
+/**
+ @brief Switch the bus clock; only call it with nothing on the bus
+ @param    speed I2C_SPEED_STANDARD or I2C_SPEED_FAST
+ @retval   0 done
+ @retval   1 F_CPU is too slow for fast mode, the speed is unchanged
+ */
+extern unsigned char i2c_setSpeed(unsigned char speed);
+
+
+/**
+ @brief Get a stuck bus going again
+
+ Clocks SCL by hand until the device releases SDA, sends a STOP and re-enables the TWI.
+ The waits below call it themselves when they time out.
+ */
+extern void i2c_recover(void);
+
+
 /** 
  @brief Terminates the data transfer and releases the I2C bus 
+
+ Also hands the bus back to the queue, which i2c_start() held off
  @return none
  */
 extern void i2c_stop(void);
@@ -111,10 +151,13 @@ extern void i2c_stop(void);
 
 /** 
  @brief Issues a start condition and sends address and transfer direction 
-  
+
+ Waits for the queue to finish, then keeps queued transfers off the bus until i2c_stop().
+ Like the queue, a step that stalls for I2C_TIMEOUT_US recovers the bus and gives I2C_ERR_TIMEOUT,
+ and a bus error or lost arbitration is stopped and gives I2C_ERR_BUS
  @param    addr address and transfer direction of I2C device
- @retval   0   device accessible 
- @retval   1   failed to access device 
+ @retval   I2C_OK   device accessible 
+ @return   otherwise one of the I2C_ERR_ codes
  */
 extern unsigned char i2c_start(unsigned char addr);
 
@@ -123,8 +166,8 @@ extern unsigned char i2c_start(unsigned char addr);
  @brief Issues a repeated start condition and sends address and transfer direction 
 
  @param   addr address and transfer direction of I2C device
- @retval  0 device accessible
- @retval  1 failed to access device
+ @retval  I2C_OK device accessible
+ @return  otherwise one of the I2C_ERR_ codes
  */
 extern unsigned char i2c_rep_start(unsigned char addr);
 
@@ -142,21 +185,21 @@ extern void i2c_start_wait(unsigned char addr);
 /**
  @brief Send one byte to I2C device
  @param    data  byte to be transfered
- @retval   0 write successful
- @retval   1 write failed
+ @retval   I2C_OK write successful
+ @return   otherwise one of the I2C_ERR_ codes
  */
 extern unsigned char i2c_write(unsigned char data);
 
 
 /**
  @brief    read one byte from the I2C device, request more data from device 
- @return   byte read from I2C device
+ @return   byte read from I2C device, 0xFF if the bus stalled or failed (and was recovered)
  */
 extern unsigned char i2c_readAck(void);
 
 /**
  @brief    read one byte from the I2C device, read is followed by a stop condition 
- @return   byte read from I2C device
+ @return   byte read from I2C device, 0xFF if the bus stalled or failed (and was recovered)
  */
 extern unsigned char i2c_readNak(void);
 
@@ -173,6 +216,81 @@ extern unsigned char i2c_read(unsigned char ack);
 #define i2c_read(ack)  (ack) ? i2c_readAck() : i2c_readNak(); 
 
 
+/** i2c_transfer_t status while it is queued or on the bus */
+#define I2C_PENDING    0xFF
+/** i2c_transfer_t status once it has finished */
+#define I2C_OK         0
+#define I2C_ERR_START  1   /**< the START did not go out */
+#define I2C_ERR_ADDR   2   /**< the device did not acknowledge its address */
+#define I2C_ERR_DATA   3   /**< the device did not acknowledge a byte written to it */
+#define I2C_ERR_BUS    4   /**< bus error or lost arbitration */
+#define I2C_ERR_TIMEOUT 5  /**< the transfer stalled and was abandoned, the bus has been recovered */
+
+/** how many transfers i2c_submit() can hold at once */
+#ifndef I2C_QUEUE_LEN
+#define I2C_QUEUE_LEN 4
+#endif
+
+/**
+ @brief A whole transaction for the interrupt driven engine
+
+ START, the address with I2C_WRITE and writeLen bytes from writeBuf, then (if readLen is not 0)
+ a repeated START, the address with I2C_READ and readLen bytes into readBuf, then STOP.
+ With writeLen 0 the read starts straight after the first START.
+ The buffers and the descriptor itself must stay put until status is no longer I2C_PENDING.
+ */
+typedef struct i2c_transfer {
+    unsigned char addr;
+    const unsigned char *writeBuf;
+    unsigned char writeLen;
+    unsigned char *readBuf;
+    unsigned char readLen;
+    volatile unsigned char status;
+    /** called from the TWI interrupt once the transfer has finished, or NULL */
+    void (*done)(struct i2c_transfer *t);
+} i2c_transfer_t;
+
+/**
+ @brief Queue a transfer and return straight away; the TWI interrupt runs it in the background
+ @retval   0 queued
+ @retval   1 the queue is full
+ */
+extern unsigned char i2c_submit(i2c_transfer_t *t);
+
+/**
+ @brief Queue a transfer and wait for it to finish; works with interrupts off too
+
+ If nothing finishes for I2C_TIMEOUT_US the transfer on the bus is abandoned, so with an empty queue
+ the wait is bounded by I2C_TIMEOUT_US plus I2C_RECOVERY_US
+ @return   the transfer's final status, I2C_OK or one of the I2C_ERR_ codes
+ */
+extern unsigned char i2c_transfer(i2c_transfer_t *t);
+
+/**
+ @brief Abandon the transfer on the bus with I2C_ERR_TIMEOUT, recover the bus and start the next one
+
+ Does nothing while the byte at a time calls hold the bus, since no queued transfer is on it
+ */
+extern void i2c_abort(void);
+
+/**
+ @brief Call every few ms (once a frame, say) while transfers are queued in the background
+
+ A transfer that has not moved since the previous call is abandoned with i2c_abort(),
+ so one can be stuck for no longer than two calls apart
+ @retval   0 all is well
+ @retval   1 a transfer was abandoned
+ */
+extern unsigned char i2c_watchdog(void);
+
+/**
+ @brief Whether the engine has nothing queued or running
+ 
+ i2c_start() waits for this before it touches the bus
+ */
+extern unsigned char i2c_idle(void);
+
+
 
 /**@}*/
 #endif
@@ -6,19 +6,29 @@
 * Target:   any AVR device with hardware TWI 
 * Usage:    API compatible with I2C Software Library i2cmaster.h
 **************************************************************************/
+/* define CPU frequency in hz here if not defined in Makefile */
+#ifndef F_CPU
+#define F_CPU 8000000UL
+#endif
+
 #include <inttypes.h>
+#include <avr/interrupt.h>
 #include <util/twi.h>
+#include <util/delay.h>
 
 #include "i2cmaster.h"
 
 
-/* define CPU frequency in hz here if not defined in Makefile */
-#ifndef F_CPU
-#define F_CPU 8000000UL
-#endif
+/* I2C clock in Hz, standard and fast mode */
+#define SCL_CLOCK       100000L
+#define SCL_CLOCK_FAST  400000L
 
-/* I2C clock in Hz */
-#define SCL_CLOCK  100000L
+/* the TWI pins, driven by hand to recover the bus */
+#define SDA_PIN  PC4
+#define SCL_PIN  PC5
+
+/* how often the waits below look at the TWI */
+#define POLL_US  10
 
 
 /*************************************************************************
@@ -34,36 +44,383 @@ void i2c_init(void)
 }/* i2c_init */
 
 
-/*************************************************************************	
-  Issues a start condition and sends address and transfer direction.
-  return 0 = device accessible, 1= failed to access device
+/*************************************************************************
+ Switch between 100 kHz and 400 kHz; only call it with the bus idle
+ Fast mode needs F_CPU of at least 16*400 kHz, so 8 MHz runs it with TWBR 2,
+ below the 10 the old AVR datasheets asked for but fine on the tiny88 as a master
 *************************************************************************/
-unsigned char i2c_start(unsigned char address)
+unsigned char i2c_setSpeed(unsigned char speed)
 {
-    uint8_t   twst;
+	if(speed == I2C_SPEED_FAST) {
+#if F_CPU >= 16*SCL_CLOCK_FAST
+		TWBR = ((F_CPU/SCL_CLOCK_FAST)-16)/2;
+		return 0;
+#else
+		return 1;
+#endif
+	}
+	TWBR = ((F_CPU/SCL_CLOCK)-16)/2;
+	return 0;
 
-	// send START condition
-	TWCR = (1<<TWINT) | (1<<TWSTA) | (1<<TWEN);
+}/* i2c_setSpeed */
 
-	// wait until transmission completed
-	while(!(TWCR & (1<<TWINT)));
 
-	// check value of TWI Status Register. Mask prescaler bits.
+/*************************************************************************
+ Free a stuck bus: with the TWI off, clock SCL until the device lets go of SDA
+ (at most 9 clocks gets it through whatever byte it was in the middle of),
+ then make a STOP by hand and turn the TWI back on
+*************************************************************************/
+void i2c_recover(void)
+{
+	uint8_t clocks;
+
+	TWCR = 0;
+	// open drain by hand: low is output driving 0, high is input with the pull-up resistors
+	PORTC &= ~((1<<SDA_PIN) | (1<<SCL_PIN));
+	DDRC &= ~((1<<SDA_PIN) | (1<<SCL_PIN));
+	for(clocks = 0; clocks < 9 && !(PINC & (1<<SDA_PIN)); clocks++) {
+		DDRC |= 1<<SCL_PIN;
+		_delay_us(5);
+		DDRC &= ~(1<<SCL_PIN);
+		_delay_us(5);
+	}
+	// STOP: SDA rises while SCL is high
+	DDRC |= 1<<SDA_PIN;
+	_delay_us(5);
+	DDRC &= ~(1<<SDA_PIN);
+	_delay_us(5);
+	TWCR = 1<<TWEN;
+
+}/* i2c_recover */
+
+
+// Wait for the TWI to finish its step; gives up after I2C_TIMEOUT_US and recovers the bus,
+//  as i2c_abort() does for the queue
+static unsigned char twi_wait(void)
+{
+	uint16_t waited;
+
+	for(waited = 0; !(TWCR & (1<<TWINT)); waited += POLL_US) {
+		if(waited >= I2C_TIMEOUT_US) {
+			i2c_recover();
+			return I2C_ERR_TIMEOUT;
+		}
+		_delay_us(POLL_US);
+	}
+	return I2C_OK;
+}
+
+// The same for a STOP going out
+static void twi_wait_stop(void)
+{
+	uint16_t waited;
+
+	for(waited = 0; TWCR & (1<<TWSTO); waited += POLL_US) {
+		if(waited >= I2C_TIMEOUT_US) {
+			i2c_recover();
+			return;
+		}
+		_delay_us(POLL_US);
+	}
+}
+
+
+/*************************************************************************
+ Interrupt driven engine: a ring of queued transfers, the oldest one on the bus
+*************************************************************************/
+static i2c_transfer_t *queue[I2C_QUEUE_LEN];
+static volatile uint8_t queueHead = 0;
+static volatile uint8_t queueCount = 0;
+// The next byte of the current transfer's write or read buffer
+static uint8_t bufIndex;
+// The current transfer is past its repeated START (or never had anything to write)
+static uint8_t reading;
+// A caller of the byte at a time calls has the bus from i2c_start() to i2c_stop(), so the queue waits
+static volatile uint8_t held = 0;
+
+#define TWCR_NEXT ((1<<TWINT) | (1<<TWEN) | (1<<TWIE))
+
+// Something happens on the bus each time the engine steps, so a watchdog can tell a stuck transfer
+static volatile uint8_t progress;
+
+// Take the finished transfer off the queue and tell its owner
+static void twi_complete(i2c_transfer_t *t, unsigned char status)
+{
+	t->status = status;
+	if(t->done) t->done(t);
+}
+
+static i2c_transfer_t *twi_pop(void)
+{
+	i2c_transfer_t *t = queue[queueHead];
+
+	queueHead = (queueHead + 1) % I2C_QUEUE_LEN;
+	queueCount--;
+	bufIndex = 0;
+	reading = 0;
+	return t;
+}
+
+static void twi_finish(unsigned char status)
+{
+	i2c_transfer_t *t = twi_pop();
+
+	if(queueCount) {
+		// STOP followed straight away by the START of the next transfer
+		TWCR = TWCR_NEXT | (1<<TWSTO) | (1<<TWSTA);
+	} else {
+		TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO);
+	}
+	twi_complete(t, status);
+}
+
+// One step of the current transfer, for whatever the TWI has just finished doing
+static void twi_step(void)
+{
+	i2c_transfer_t *t = queue[queueHead];
+
+	progress++;
+	switch(TW_STATUS & 0xF8) {
+	case TW_START:
+	case TW_REP_START:
+		if(!t->writeLen && t->readLen) reading = 1;
+		TWDR = t->addr | (reading ? I2C_READ : I2C_WRITE);
+		TWCR = TWCR_NEXT;
+		break;
+	case TW_MT_SLA_ACK:
+	case TW_MT_DATA_ACK:
+		if(bufIndex < t->writeLen) {
+			TWDR = t->writeBuf[bufIndex++];
+			TWCR = TWCR_NEXT;
+		} else if(t->readLen) {
+			reading = 1;
+			bufIndex = 0;
+			TWCR = TWCR_NEXT | (1<<TWSTA);
+		} else {
+			twi_finish(I2C_OK);
+		}
+		break;
+	case TW_MR_SLA_ACK:
+		// ACK every byte but the last, which is NACKed to tell the device to stop
+		TWCR = TWCR_NEXT | (t->readLen > 1 ? (1<<TWEA) : 0);
+		break;
+	case TW_MR_DATA_ACK:
+		t->readBuf[bufIndex++] = TWDR;
+		TWCR = TWCR_NEXT | (bufIndex + 1 < t->readLen ? (1<<TWEA) : 0);
+		break;
+	case TW_MR_DATA_NACK:
+		t->readBuf[bufIndex] = TWDR;
+		twi_finish(I2C_OK);
+		break;
+	case TW_MT_SLA_NACK:
+	case TW_MR_SLA_NACK:
+		twi_finish(I2C_ERR_ADDR);
+		break;
+	case TW_MT_DATA_NACK:
+		twi_finish(I2C_ERR_DATA);
+		break;
+	default:
+		// TW_BUS_ERROR, TW_MT_ARB_LOST or anything else unexpected
+		twi_finish(I2C_ERR_BUS);
+		break;
+	}
+}
+
+ISR(TWI_vect)
+{
+	twi_step();
+}
+
+// With interrupts off the TWI interrupt can't run, so do its work here instead
+static void twi_poll(void)
+{
+	if(!(SREG & (1<<SREG_I)) && (TWCR & (1<<TWIE)) && (TWCR & (1<<TWINT))) {
+		twi_step();
+	}
+}
+
+// Wait for the queue to empty and its last STOP to go out
+static void twi_drain(void)
+{
+	uint16_t waited;
+
+	for(waited = 0; queueCount; waited += POLL_US) {
+		twi_poll();
+		if(waited >= I2C_TIMEOUT_US) {
+			i2c_abort();
+			waited = 0;
+		}
+		_delay_us(POLL_US);
+	}
+	twi_wait_stop();
+}
+
+
+// Put the first queued transfer on the bus; interrupts must be off
+static void twi_begin(void)
+{
+	// the STOP that ended the last transfer may still be going out
+	twi_wait_stop();
+	bufIndex = 0;
+	reading = 0;
+	TWCR = TWCR_NEXT | (1<<TWSTA);
+}
+
+
+void i2c_abort(void)
+{
+	uint8_t sreg = SREG;
+	i2c_transfer_t *t;
+
+	cli();
+	// while the bus is held nothing queued is on it, and the byte at a time calls time out themselves
+	if(!queueCount || held) {
+		SREG = sreg;
+		return;
+	}
+	i2c_recover();
+	t = twi_pop();
+	if(queueCount) {
+		TWCR = TWCR_NEXT | (1<<TWSTA);
+	}
+	twi_complete(t, I2C_ERR_TIMEOUT);
+	SREG = sreg;
+
+}/* i2c_abort */
+
+
+unsigned char i2c_watchdog(void)
+{
+	static uint8_t seen;
+	static uint8_t armed = 0;
+
+	if(!queueCount || held) {
+		armed = 0;
+		return 0;
+	}
+	if(armed && progress == seen) {
+		armed = 0;
+		i2c_abort();
+		return 1;
+	}
+	seen = progress;
+	armed = 1;
+	return 0;
+
+}/* i2c_watchdog */
+
+
+unsigned char i2c_submit(i2c_transfer_t *t)
+{
+	uint8_t sreg = SREG;
+
+	cli();
+	if(queueCount == I2C_QUEUE_LEN) {
+		SREG = sreg;
+		return 1;
+	}
+	t->status = I2C_PENDING;
+	queue[(queueHead + queueCount) % I2C_QUEUE_LEN] = t;
+	if(queueCount++ == 0 && !held) {
+		twi_begin();
+	}
+	SREG = sreg;
+	return 0;
+
+}/* i2c_submit */
+
+
+unsigned char i2c_transfer(i2c_transfer_t *t)
+{
+	uint16_t waited;
+
+	while(i2c_submit(t)) twi_drain();
+	// the loop overhead makes the real limit a little longer than I2C_TIMEOUT_US, never shorter
+	for(waited = 0; t->status == I2C_PENDING; waited += POLL_US) {
+		twi_poll();
+		if(waited >= I2C_TIMEOUT_US) {
+			// whatever is on the bus is holding this one up, so that is the one to abandon
+			i2c_abort();
+			waited = 0;
+		}
+		_delay_us(POLL_US);
+	}
+	return t->status;
+
+}/* i2c_transfer */
+
+
+unsigned char i2c_idle(void)
+{
+	return queueCount == 0;
+
+}/* i2c_idle */
+
+
+/*************************************************************************
+ The byte at a time calls: the caller drives the bus one step per call and
+ keeps it from i2c_start() to i2c_stop(), so they can't be whole queued
+ transfers; they poll the TWI themselves, with the queue held off, and
+ recover from a stall or a bus error the way the queue does
+*************************************************************************/
+
+// Wait for the queue to finish with the bus, then keep it off until i2c_stop()
+static void twi_hold(void)
+{
+	uint8_t sreg = SREG;
+
+	if(held) return;
+	for(;;) {
+		cli();
+		if(!queueCount) break;
+		SREG = sreg;
+		twi_drain();
+	}
+	held = 1;
+	SREG = sreg;
+	twi_wait_stop();
+}
+
+// A status the caller didn't expect: a bus error or lost arbitration gets the STOP the queue
+//  ends one with, anything else (a NACK) is left for the caller to stop
+static unsigned char twi_fail(uint8_t twst, unsigned char status)
+{
+	if(twst == TW_BUS_ERROR || twst == TW_MT_ARB_LOST) {
+		TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO);
+		twi_wait_stop();
+		return I2C_ERR_BUS;
+	}
+	return status;
+}
+
+// START (or repeated START) and the address
+static unsigned char twi_address(unsigned char address)
+{
+	uint8_t twst;
+
+	TWCR = (1<<TWINT) | (1<<TWSTA) | (1<<TWEN);
+	if(twi_wait()) return I2C_ERR_TIMEOUT;
 	twst = TW_STATUS & 0xF8;
-	if ( (twst != TW_START) && (twst != TW_REP_START)) return 1;
+	if((twst != TW_START) && (twst != TW_REP_START)) return twi_fail(twst, I2C_ERR_START);
 
-	// send device address
 	TWDR = address;
 	TWCR = (1<<TWINT) | (1<<TWEN);
-
-	// wail until transmission completed and ACK/NACK has been received
-    while(!(TWCR & (1<<TWINT)));
-
-	// check value of TWI Status Register. Mask prescaler bits.
+	if(twi_wait()) return I2C_ERR_TIMEOUT;
 	twst = TW_STATUS & 0xF8;
-	if ( (twst != TW_MT_SLA_ACK) && (twst != TW_MR_SLA_ACK) ) return 2;
+	if((twst != TW_MT_SLA_ACK) && (twst != TW_MR_SLA_ACK)) return twi_fail(twst, I2C_ERR_ADDR);
+	return I2C_OK;
+}
 
-	return 0;
+
+/*************************************************************************	
+  Issues a start condition and sends address and transfer direction.
+  return I2C_OK = device accessible, one of the I2C_ERR_ codes otherwise
+*************************************************************************/
+unsigned char i2c_start(unsigned char address)
+{
+	// let the interrupt driven engine finish with the bus first
+	twi_hold();
+	return twi_address(address);
 
 }/* i2c_start */
 
@@ -76,42 +433,27 @@ unsigned char i2c_start(unsigned char address)
 *************************************************************************/
 void i2c_start_wait(unsigned char address)
 {
-    uint8_t   twst;
+    uint8_t   tries;
 
+	twi_hold();
 
-    while ( 1 )
+    // a device that never answers would otherwise keep us here forever
+    for ( tries = 0; tries < I2C_START_RETRIES; tries++ )
     {
-	    // send START condition
-	    TWCR = (1<<TWINT) | (1<<TWSTA) | (1<<TWEN);
-    
-    	// wait until transmission completed
-    	while(!(TWCR & (1<<TWINT)));
-    
-    	// check value of TWI Status Register. Mask prescaler bits.
-    	twst = TW_STATUS & 0xF8;
-    	if ( (twst != TW_START) && (twst != TW_REP_START)) continue;
-    
-    	// send device address
-    	TWDR = address;
-    	TWCR = (1<<TWINT) | (1<<TWEN);
-    
-    	// wail until transmission completed
-    	while(!(TWCR & (1<<TWINT)));
-    
-    	// check value of TWI Status Register. Mask prescaler bits.
-    	twst = TW_STATUS & 0xF8;
-    	if ( (twst == TW_MT_SLA_NACK )||(twst ==TW_MR_DATA_NACK) ) 
-    	{    	    
+    	switch(twi_address(address)) {
+    	case I2C_OK:
+    	    return;
+    	case I2C_ERR_ADDR:
     	    /* device busy, send stop condition to terminate write operation */
 	        TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO);
 	        
 	        // wait until stop condition is executed and bus released
-	        while(TWCR & (1<<TWSTO));
-	        
-    	    continue;
+	        twi_wait_stop();
+	        break;
+    	default:
+    	    // timed out or a bus error, the bus has been recovered or stopped
+    	    break;
     	}
-    	//if( twst != TW_MT_SLA_ACK) return 1;
-    	break;
      }
 
 }/* i2c_start_wait */
@@ -122,8 +464,8 @@ void i2c_start_wait(unsigned char address)
 
  Input:   address and transfer direction of I2C device
  
- Return:  0 device accessible
-          1 failed to access device
+ Return:  I2C_OK device accessible
+          one of the I2C_ERR_ codes otherwise
 *************************************************************************/
 unsigned char i2c_rep_start(unsigned char address)
 {
@@ -137,11 +479,21 @@ unsigned char i2c_rep_start(unsigned char address)
 *************************************************************************/
 void i2c_stop(void)
 {
+	uint8_t sreg = SREG;
+
     /* send stop condition */
 	TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO);
 	
 	// wait until stop condition is executed and bus released
-	while(TWCR & (1<<TWSTO));
+	twi_wait_stop();
+
+	// hand the bus back to the queue, and start whatever was submitted meanwhile
+	cli();
+	if(held) {
+		held = 0;
+		if(queueCount) twi_begin();
+	}
+	SREG = sreg;
 
 }/* i2c_stop */
 
@@ -150,8 +502,8 @@ void i2c_stop(void)
   Send one byte to I2C device
   
   Input:    byte to be transfered
-  Return:   0 write successful 
-            1 write failed
+  Return:   I2C_OK write successful 
+            one of the I2C_ERR_ codes otherwise
 *************************************************************************/
 unsigned char i2c_write( unsigned char data )
 {	
@@ -162,12 +514,12 @@ unsigned char i2c_write( unsigned char data )
 	TWCR = (1<<TWINT) | (1<<TWEN);
 
 	// wait until transmission completed
-	while(!(TWCR & (1<<TWINT)));
+	if(twi_wait()) return I2C_ERR_TIMEOUT;
 
 	// check value of TWI Status Register. Mask prescaler bits
 	twst = TW_STATUS & 0xF8;
-	if( twst != TW_MT_DATA_ACK) return 1;
-	return 0;
+	if( twst != TW_MT_DATA_ACK) return twi_fail(twst, I2C_ERR_DATA);
+	return I2C_OK;
 
 }/* i2c_write */
 
@@ -175,12 +527,16 @@ unsigned char i2c_write( unsigned char data )
 /*************************************************************************
  Read one byte from the I2C device, request more data from device 
  
- Return:  byte read from I2C device
+ Return:  byte read from I2C device, 0xFF if the bus stalled or failed
 *************************************************************************/
 unsigned char i2c_readAck(void)
 {
 	TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWEA);
-	while(!(TWCR & (1<<TWINT)));    
+	if(twi_wait()) return 0xFF;
+	if((TW_STATUS & 0xF8) != TW_MR_DATA_ACK) {
+		twi_fail(TW_STATUS & 0xF8, I2C_ERR_BUS);
+		return 0xFF;
+	}
 
     return TWDR;
 
@@ -190,12 +546,16 @@ unsigned char i2c_readAck(void)
 /*************************************************************************
  Read one byte from the I2C device, read is followed by a stop condition 
  
- Return:  byte read from I2C device
+ Return:  byte read from I2C device, 0xFF if the bus stalled or failed
 *************************************************************************/
 unsigned char i2c_readNak(void)
 {
 	TWCR = (1<<TWINT) | (1<<TWEN);
-	while(!(TWCR & (1<<TWINT)));
+	if(twi_wait()) return 0xFF;
+	if((TW_STATUS & 0xF8) != TW_MR_DATA_NACK) {
+		twi_fail(TW_STATUS & 0xF8, I2C_ERR_BUS);
+		return 0xFF;
+	}
 	
     return TWDR;
 
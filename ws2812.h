@@ -1,11 +1,82 @@
-
 #ifndef __WS2812_H__
 # define __WS2812_H__
 
 #include <stdint.h>
 #include <avr/cpufunc.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <util/delay.h>
+#include "frame.h"
+
+// Which hardware drives the LED data line
+//  WS2812_BITBANG: PC7, every bit timed with nops, so interrupts are off for the whole frame
+//  WS2812_SPI: MOSI (PB3) driven by the SPI peripheral, which shapes the pulses itself;
+//   interrupts stay on, but every source is masked for the frame; the 1ms ticks it misses are
+//   counted and handed to frame_addTicks() (frame.h) at the end
+#define WS2812_BITBANG 0
+#define WS2812_SPI 1
+#ifndef WS2812_BACKEND
+#define WS2812_BACKEND WS2812_BITBANG
+#endif
+
+// Pulse widths the LEDs need, in ns; a high pulse shorter than about 550ns reads as a 0, longer as a 1
+// The targets are what the hand-tuned 8MHz sequence produced (3 and 7 cycles)
+#define WS2812_T0H_NS 375
+#define WS2812_T1H_NS 875
+// The window each must land in once rounded to whole cycles
+#define WS2812_T0H_MIN_NS 200
+#define WS2812_T0H_MAX_NS 500
+#define WS2812_T1H_MIN_NS 625
+#define WS2812_T1H_MAX_NS 1000
+// The line may sit low between bits for this long before the LEDs take it as the end of the frame
+// The datasheets' 50us is only the reset every LED is sure to see; some latch after as little as 6us, so
+//  anything that can leave the line low mid-frame (the bit loop, the stream renderer's per-LED work, an
+//  interrupt under the SPI back end) is held to this one limit
+#define WS2812_TLOW_MAX_NS 5000
+
+// WS2812_GAP_STATS: time the gap between one LED's last bit and the next LED's first with Timer1, which
+//  has to be counting every cycle (the benchmarks run it so), keeping the longest in ws2812_gap_max
+// The build that turns it on defines ws2812_gap_max; the timing adds to every frame, so only bench_gap does
+#ifndef WS2812_GAP_STATS
+#define WS2812_GAP_STATS 0
+#endif
+#if WS2812_GAP_STATS
+extern uint16_t ws2812_gap_max;
+static uint16_t ws2812_gap_from;
+// Cleared at the end of each frame, so the time between frames isn't taken for a gap
+static uint8_t ws2812_gap_timing;
+#endif
+
+// Nanoseconds to the nearest CPU cycle, and back
+#define WS2812_CYCLES(ns) (((ns)*(F_CPU/1000UL) + 500000UL)/1000000UL)
+#define WS2812_NS(cycles) ((cycles)*1000000UL/(F_CPU/1000UL))
+
+#if WS2812_BACKEND == WS2812_BITBANG
+
+// A high pulse runs from the end of the sbi to the end of the cbi: the nops plus the cbi's 2 cycles
+#define WS2812_T0H_CYCLES WS2812_CYCLES(WS2812_T0H_NS)
+#define WS2812_T1H_CYCLES WS2812_CYCLES(WS2812_T1H_NS)
+#define WS2812_T0H_NOPS (WS2812_T0H_CYCLES-2)
+#define WS2812_T1H_NOPS (WS2812_T1H_CYCLES-2)
+// A 0 idles low after its pulse for half the difference, to even out the two bit periods
+#define WS2812_T0L_NOPS ((WS2812_T1H_CYCLES-WS2812_T0H_CYCLES)/2)
+// The loop between bits (shift, test, branch) adds about this many cycles of low time, plus the sbi's 2
+#define WS2812_LOOP_CYCLES 6
+// The longest a bit leaves the line low before the next one's pulse, a 0's; a gap between LEDs adds to it
+#define WS2812_BIT_LOW_CYCLES (WS2812_LOOP_CYCLES+2+WS2812_T0L_NOPS)
+
+#if WS2812_T0H_CYCLES < 2
+#error "F_CPU is too slow to bit-bang WS2812 0 bits: the cbi alone is longer than a 0 pulse"
+#endif
+#if WS2812_NS(WS2812_T0H_CYCLES) < WS2812_T0H_MIN_NS || WS2812_NS(WS2812_T0H_CYCLES) > WS2812_T0H_MAX_NS
+#error "No whole number of cycles at this F_CPU gives a WS2812 0 pulse in spec"
+#endif
+#if WS2812_NS(WS2812_T1H_CYCLES) < WS2812_T1H_MIN_NS || WS2812_NS(WS2812_T1H_CYCLES) > WS2812_T1H_MAX_NS
+#error "No whole number of cycles at this F_CPU gives a WS2812 1 pulse in spec"
+#endif
+#if WS2812_NS(WS2812_BIT_LOW_CYCLES) > WS2812_TLOW_MAX_NS
+#error "F_CPU is too slow for the loop between WS2812 bits: the LEDs would latch mid-frame"
+#endif
 
 #define PIN_LED PC7
 #define PORT_LED ((&PORTC)-__SFR_OFFSET)
@@ -20,36 +91,160 @@ static inline void ws2812_send_single_byte(uint8_t byte)
 	for(uint8_t mask = 0x80; mask != 0; mask >>= 1) {
 		if(byte & mask) {
 			__asm__ __volatile__("sbi %0, %1 \n\t"
+					     ".rept %2 \n\t"
 					     "nop \n\t"
-					     "nop \n\t"
-					     "nop \n\t"
-					     "nop \n\t"
-					     "nop \n\t"
+					     ".endr \n\t"
 					     "cbi %0, %1 \n\t"
 					     :
-					     : "i" (PORT_LED), "i" (PIN_LED)
+					     : "i" (PORT_LED), "i" (PIN_LED), "i" (WS2812_T1H_NOPS)
 					     :
 					);
 		} else {
 			__asm__ __volatile__("sbi %0, %1 \n\t"
+					     ".rept %2 \n\t"
 					     "nop \n\t"
+					     ".endr \n\t"
 					     "cbi %0, %1 \n\t"
+					     ".rept %3 \n\t"
 					     "nop \n\t"
-					     "nop \n\t"
+					     ".endr \n\t"
 					     :
-					     : "i" (PORT_LED), "i" (PIN_LED)
+					     : "i" (PORT_LED), "i" (PIN_LED), "i" (WS2812_T0H_NOPS), "i" (WS2812_T0L_NOPS)
 					     :
 					);
 		}
 	}
 }
 
+// Any interrupt mid-frame would stretch a high pulse and corrupt the data
+static inline void ws2812_frame_begin(void)
+{
+	cli();
+}
+
+static inline void ws2812_frame_end(void)
+{
+#if WS2812_GAP_STATS
+	ws2812_gap_timing = 0;
+#endif
+	sei();
+}
+
+#elif WS2812_BACKEND == WS2812_SPI
+
+// The SPI runs at F_CPU/2 and each WS2812 bit is sent as four SPI bits:
+//  0 is 1000 (one SPI bit high), 1 is 1110 (three high), so one SPI byte carries two WS2812 bits
+// At 8MHz that is 250ns and 750ns
+#if WS2812_NS(2) < WS2812_T0H_MIN_NS || WS2812_NS(2) > WS2812_T0H_MAX_NS
+#error "At this F_CPU one SPI bit is not a WS2812 0 pulse in spec"
+#endif
+#if WS2812_NS(6) < WS2812_T1H_MIN_NS || WS2812_NS(6) > WS2812_T1H_MAX_NS
+#error "At this F_CPU three SPI bits are not a WS2812 1 pulse in spec"
+#endif
+// A 0 ends with three low SPI bits; a gap between LEDs adds to them
+#define WS2812_BIT_LOW_CYCLES 6
+#define WS2812_SPI_ZEROS 0x88
+#define WS2812_SPI_HIGH_ONE 0x60
+#define WS2812_SPI_LOW_ONE 0x06
+
+static inline void ws2812_init(void)
+{
+	// SS has to be an output for the SPI to stay in master mode
+	DDRB |= (1 << PB3) | (1 << PB5) | (1 << PB2);
+	SPCR = (1 << SPE) | (1 << MSTR);
+	SPSR = 1 << SPI2X;
+	// Send one idle byte so SPIF is already set for the first real one
+	SPDR = 0;
+}
+
+// 1ms ticks counted by ws2812_send_single_byte() while the tick interrupt is masked
+static uint8_t ws2812_ticks;
+
+static inline void ws2812_send_single_byte(uint8_t byte)
+{
+	for(uint8_t pair = 0; pair < 4; pair++) {
+		uint8_t pattern = WS2812_SPI_ZEROS;
+		if(byte & 0x80) {
+			pattern |= WS2812_SPI_HIGH_ONE;
+		}
+		if(byte & 0x40) {
+			pattern |= WS2812_SPI_LOW_ONE;
+		}
+		byte <<= 2;
+		// Every pattern ends low, so waiting here only stretches a low period
+		while(!(SPSR & (1 << SPIF)));
+		SPDR = pattern;
+	}
+	// Count a 1ms tick that came during the byte, while the SPI is busy sending its last pattern;
+	//  a byte is far shorter than a tick, so none can be missed
+	if(TIFR0 & (1 << OCF0A)) {
+		TIFR0 = 1 << OCF0A;
+		ws2812_ticks++;
+	}
+}
+
+// Interrupt enables put aside for the frame, restored by ws2812_frame_end()
+static uint8_t ws2812_saved_eimsk, ws2812_saved_pcicr, ws2812_saved_twie, ws2812_saved_timsk0;
+
+// An ISR holds the line low until it returns, and past WS2812_TLOW_MAX_NS (40 cycles at 8MHz, 20 at 4MHz)
+//  the LEDs latch mid-frame; even the Timer0 tick is longer than that with its entry and exit, so
+//  every source is masked and their flags run at the end
+// TWINT is written as 0 so a pending TWI step isn't cleared
+static inline void ws2812_frame_begin(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	ws2812_saved_eimsk = EIMSK;
+	ws2812_saved_pcicr = PCICR;
+	ws2812_saved_twie = TWCR & (1 << TWIE);
+	ws2812_saved_timsk0 = TIMSK0;
+	EIMSK = 0;
+	PCICR = 0;
+	TWCR &= ~((1 << TWIE) | (1 << TWINT));
+	TIMSK0 = 0;
+	ws2812_ticks = 0;
+	SREG = sreg;
+}
+
+// Wait for the last byte to leave, so the latch time starts from the real end of the frame
+static inline void ws2812_frame_end(void)
+{
+#if WS2812_GAP_STATS
+	ws2812_gap_timing = 0;
+#endif
+	while(!(SPSR & (1 << SPIF)));
+	uint8_t sreg = SREG;
+	cli();
+	EIMSK = ws2812_saved_eimsk;
+	PCICR = ws2812_saved_pcicr;
+	TWCR = (TWCR & ~(1 << TWINT)) | ws2812_saved_twie;
+	TIMSK0 = ws2812_saved_timsk0;
+	SREG = sreg;
+	// A compare still pending runs its own ISR now; the ones counted during the frame are run here
+	if(ws2812_ticks) {
+		frame_addTicks(ws2812_ticks);
+	}
+}
+
+#else
+#error "Unknown WS2812_BACKEND"
+#endif
+
 static inline void ws2812_set_single(uint8_t r, uint8_t g, uint8_t b)
 {
+#if WS2812_GAP_STATS
+	uint16_t gap = TCNT1 - ws2812_gap_from;
+	if(ws2812_gap_timing && gap > ws2812_gap_max) {
+		ws2812_gap_max = gap;
+	}
+#endif
 	ws2812_send_single_byte(g);
 	ws2812_send_single_byte(r);
 	ws2812_send_single_byte(b);
+#if WS2812_GAP_STATS
+	ws2812_gap_timing = 1;
+	ws2812_gap_from = TCNT1;
+#endif
 }
 
 #endif // __WS2812_H__
-